@@ -112,4 +112,22 @@ vec3 OffsetRay(in vec3 p, in vec3 n)
               abs(p.z) < origin ? p.z + floatScale * n.z : p_i.z);
 }
 
+//-------------------------------------------------------------------------------------------------
+// #HalfPrec : Kahan-compensated running mean for the RGBA16F accumulation mode. The residual
+// image carries what the half-precision store of the previous frame rounded away; subtracting
+// it from the update keeps the mean converging like the full-precision target instead of
+// stalling once the per-frame increment drops below half precision.
+//-----------------------------------------------------------------------
+vec3 AccumulateCompensated(ivec2 imageCoords, vec3 old_color, vec3 pixelColor)
+{
+  vec3 carry = imageLoad(residualImage, imageCoords).xyz;
+  vec3 exact = old_color + (pixelColor - old_color) / float(rtxState.frame + 1) - carry;
+
+  // Replicate the half rounding of the result store, so the carry holds exactly what the next
+  // frame will be missing when it reads the image back
+  vec3 stored = vec3(unpackHalf2x16(packHalf2x16(exact.xy)), unpackHalf2x16(packHalf2x16(vec2(exact.z, 0))).x);
+  imageStore(residualImage, imageCoords, vec4(stored - exact, 0));
+  return exact;
+}
+
 #endif  // RAYCOMMON_GLSL
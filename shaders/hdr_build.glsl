@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//-------------------------------------------------------------------------------------------------
+// #HdrBuild : layout and helpers of the alias-map builder kernels, shared by the hdr_*.comp
+// entry points (see hdr_sampling.cpp).
+//
+// The build mirrors the former CPU construction: a reduction for the radiance integral, a
+// partition of the texels into below / above average, prefix sums over their deficits and
+// excesses, and a pairing pass that matches each below-average texel to the above-average
+// texel whose cumulative excess covers its cumulative deficit.
+
+#ifndef HDR_BUILD_GLSL
+#define HDR_BUILD_GLSL 1
+
+#include "host_device.h"
+
+#define HDR_BUILD_PI 3.14159265358979323846
+
+// clang-format off
+layout(set = 0, binding = eHdrSource)			uniform sampler2D	hdrSource;
+layout(set = 0, binding = eHdrAccel,	 scalar)	buffer _HdrAccel	{ EnvAccel buildAccel[]; };
+layout(set = 0, binding = eHdrInfo,		 scalar)	buffer _HdrInfo		{ HdrBuildInfo buildInfo; };
+layout(set = 0, binding = eHdrScratch,	 scalar)	buffer _HdrScratch	{ float prefix[]; };
+layout(set = 0, binding = eHdrPartition, scalar)	buffer _HdrPartition{ uint partTable[]; };
+layout(set = 0, binding = eHdrPartials,	 scalar)	buffer _HdrPartials	{ vec2 partials[]; };
+// clang-format on
+
+layout(push_constant) uniform _HdrBuildState
+{
+  HdrBuildState buildState;
+};
+
+//-----------------------------------------------------------------------
+// Amount of energy emitted through a texel: its maximum channel weighted by the solid
+// angle it subtends (the same weighting the former CPU build used)
+//
+float HdrImportance(ivec2 px)
+{
+  const float stepPhi   = 2.0 * HDR_BUILD_PI / float(buildState.hdrSize.x);
+  const float stepTheta = HDR_BUILD_PI / float(buildState.hdrSize.y);
+  const float cosTheta0 = cos(float(px.y) * stepTheta);
+  const float cosTheta1 = cos(float(px.y + 1) * stepTheta);
+  const float area      = (cosTheta0 - cosTheta1) * stepPhi;  // solid angle
+
+  vec3 color = texelFetch(hdrSource, px, 0).xyz;
+  return area * max(color.x, max(color.y, color.z));
+}
+
+//-----------------------------------------------------------------------
+// CIE luminance
+//
+float HdrLuminance(ivec2 px)
+{
+  vec3 color = texelFetch(hdrSource, px, 0).xyz;
+  return color.x * 0.2126 + color.y * 0.7152 + color.z * 0.0722;
+}
+
+#endif  // HDR_BUILD_GLSL
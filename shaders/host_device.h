@@ -30,6 +30,7 @@
 #include "nvmath/nvmath.h"
 // GLSL Type
 using ivec2 = nvmath::vec2i;
+using ivec4 = nvmath::vec4i;
 using vec2  = nvmath::vec2f;
 using vec3  = nvmath::vec3f;
 using vec4  = nvmath::vec4f;
@@ -64,24 +65,54 @@ END_ENUM();
 
 // Output image - Set 1
 START_ENUM(OutputBindings)
-  eSampler = 0,  // As sampler
-  eStore   = 1   // As storage
+  eSampler       = 0,  // As sampler
+  eStore         = 1,  // As storage
+  eMoments       = 2,  // Luminance moments for adaptive sampling
+  eStats         = 3,  // Converged pixel counter
+  eDenoiseRGB    = 4,  // #Denoise : result buffer shared with Cuda
+  eDenoiseAlbedo = 5,  // #Denoise : albedo guide layer shared with Cuda
+  eDenoiseNormal = 6,  // #Denoise : normal guide layer shared with Cuda
+  eDenoiseFlow   = 7,  // #Denoise : motion vectors for the temporal model
+  eReproject     = 8,  // #Reproject : this frame's color + primary depth, copied to the history
+  eHistory       = 9,  // #Reproject : last completed frame, warped after a camera move
+  eResidual      = 10  // #HalfPrec : accumulation error carry of the half-precision mode
 END_ENUM();
 
 // Scene Data - Set 2
 START_ENUM(SceneBindings)
-  eCamera    = 0, 
-  eMaterials = 1, 
-  eInstData  = 2, 
-  eLights    = 3,            
-  eTextures  = 4  // must be last elem            
+  eCamera     = 0,
+  eMaterials  = 1,
+  eInstData   = 2,
+  eLights     = 3,
+  eLightAccel = 4,  // #LightAccel : power-based alias table over the lights
+  eViews      = 5,  // #MultiView : per-view camera matrices of the sensor rig
+  eTextures   = 6   // must be last elem
 END_ENUM();
 
 // Environment - Set 3
 START_ENUM(EnvBindings)
-  eSunSky     = 0, 
-  eHdr        = 1, 
-  eImpSamples = 2 
+  eSunSky     = 0,
+  eHdr        = 1,
+  eImpSamples = 2,
+  eRayStats   = 3  // #Stats : atomic ray counters
+END_ENUM();
+
+// #Wavefront : extra data of the wavefront path tracer - Set 4
+START_ENUM(WFBindings)
+  eWFPathStates = 0,  // Per-pixel path state, alive across the kernels of a bounce
+  eWFQueues     = 1,  // Ray index queues and their dispatch-indirect headers
+  eWFInstances  = 2   // Per TLAS-instance transforms, to rebuild the hit payload
+END_ENUM();
+
+// #HdrBuild : bindings of the alias-map builder kernels (hdr_*.comp), a set of their own
+// that only lives while an environment is loaded
+START_ENUM(HdrBuildBindings)
+  eHdrSource    = 0,  // The environment texture
+  eHdrAccel     = 1,  // EnvAccel being built, bound as eImpSamples once done
+  eHdrInfo      = 2,  // HdrBuildInfo, read back by the host for the integral and average
+  eHdrScratch   = 3,  // Per-texel deficit / excess, turned into prefix sums by the scans
+  eHdrPartition = 4,  // Texel indices, below-average from the front, above-average from the back
+  eHdrPartials  = 5   // Per-workgroup partials of the reduction and the scans
 END_ENUM();
 
 START_ENUM(DebugMode)
@@ -106,10 +137,25 @@ END_ENUM();
 struct SceneCamera {
   mat4  viewInverse;
   mat4  projInverse;
+  mat4  viewProj;      // #Reproject : this frame's view-projection, for the depth of the history
+  mat4  prevViewProj;  // #Denoise : last frame's view-projection, for the motion vectors
   float focalDist;
   float aperture;
   // Extra
   int nbLights;
+  // #MultiView : number of sensor-rig views and their atlas grid; 1 renders the plain camera
+  int   nbViews;
+  ivec2 viewGrid;
+};
+
+// #MultiView : upper bound of the sensor-rig views rendered as an atlas by one dispatch
+#define MULTIVIEW_MAX_VIEWS 16
+
+// #MultiView : one camera of the sensor rig; all views share the TLAS, the scene buffers and
+// the pipeline, only the matrices differ per atlas tile
+struct SceneView {
+  mat4 viewInverse;
+  mat4 projInverse;
 };
 
 struct VertexAttributes {
@@ -179,6 +225,23 @@ struct GltfShadeMaterial {
   // 52
 };
 
+// Minimum number of accumulated frames before adaptive sampling may stop a pixel
+#define ADAPTIVE_MIN_FRAMES 16
+
+// #Reproject : weight of a warped history sample, counted as this many accumulated frames,
+// and the relative depth difference above which a pixel is treated as disoccluded
+#define REPROJECT_SEED_FRAMES 8
+#define REPROJECT_DEPTH_TOLERANCE 0.05f
+
+// #Stats : per-frame ray counters, incremented with atomics when RAY_STATISTICS is on.
+// The buffer is host visible; the host reads the previous frame and clears it.
+struct RayStats {
+  uint primaryRays;  // Camera rays (first segment of each path)
+  uint bounceRays;   // Continuation segments after the first hit
+  uint shadowRays;   // Light visibility tests
+  uint anyHits;      // Anyhit shader / alpha-test invocations
+};
+
 // Use with PushConstant
 struct RtxState {
   int   frame;                  // Current frame, start at 0
@@ -188,11 +251,15 @@ struct RtxState {
   float hdrMultiplier;          // To brightening the scene
   int   debugging_mode;         // See DebugMode
   int   pbrMode;                // 0-Disney, 1-Gltf
-  int   _pad0;                  // vec2 need alignment
+  int   denoiseWrite;           // #Denoise : also write result and guide layers to the shared buffers
   ivec2 size;                   // rendering size
   int   minHeatmap;             // Debug mode - heat map
   int   maxHeatmap;
   int   accumulate;
+  ivec2 tileOffset;             // Origin of the tile being rendered ((0,0) without tiling)
+  int   adaptiveSampling;       // Stop tracing converged pixels (see momentsImage)
+  float adaptiveThreshold;      // Relative standard error below which a pixel is converged
+  int   reproject;              // #Reproject : 0 off, 1 keep the history, 2 also seed from it (frame 0)
 };
 
 // Structure used for retrieving the primitive information in the closest hit
@@ -203,6 +270,39 @@ struct InstanceData {
   int      materialIndex;
 };
 
+// #Wavefront : threads per group of the trace and shade kernels (1D over the ray queue)
+#define WAVEFRONT_GROUP_SIZE 256
+
+// #Wavefront : queue header, laid out as a VkDispatchIndirectCommand so the next kernel is
+// launched straight from it. The push grows groupsX with an atomicMax; groupsY/Z stay 1.
+struct WaveQueue {
+  uint groupsX;
+  uint groupsY;
+  uint groupsZ;
+  uint count;  // Rays pushed in this queue
+};
+
+// #Wavefront : everything a path keeps alive between the kernels of a bounce, at a fixed
+// slot per pixel; the queues only carry pixel indices. The w components double as storage
+// for the intersection result, so the state stays at 8 vec4 per pixel.
+struct WavePathState {
+  vec4  origin;      // xyz: ray origin
+  vec4  direction;   // xyz: ray direction         w: hit distance (INFINITY on miss)
+  vec4  radiance;    // xyz: accumulated radiance  w: barycentric u of the hit
+  vec4  throughput;  // xyz: path throughput       w: barycentric v of the hit
+  vec4  absorption;  // xyz: volume absorption
+  ivec4 hit;         // x: primitiveID  y: instanceID  z: instanceCustomIndex  w: rng seed
+  vec4  primary;     // xyz: first-hit position, w: 1 when the primary ray hit (#Denoise, #Reproject)
+  vec4  sampleSum;   // xyz: radiance summed over the samples of this frame
+};
+
+// #Wavefront : per TLAS-instance transforms, indexed with the instanceID of the hit; the
+// shade kernel rebuilds the payload matrices from it instead of carrying them per ray
+struct WaveInstance {
+  mat4 objectToWorld;
+  mat4 worldToObject;
+};
+
 // KHR_lights_punctual extension.
 // see https://github.com/KhronosGroup/glTF/tree/master/extensions/2.0/Khronos/KHR_lights_punctual
 
@@ -234,6 +334,33 @@ struct EnvAccel {
   float aliasPdf;
 };
 
+// #LightAccel : alias table over the punctual lights, built in scene.cpp at load time so
+// DirectLight picks lights proportionally to their estimated power. pdf is the absolute
+// selection probability of the light.
+struct LightAccel {
+  uint  alias;
+  float q;
+  float pdf;
+};
+
+// #HdrBuild : threads per group of the alias-map builder kernels (1D over the texels)
+#define HDR_BUILD_GROUP_SIZE 256
+
+// #HdrBuild : results and atomic allocators of the GPU alias-map build. The host only reads
+// integral and average back; the counters partition the texels on the device.
+struct HdrBuildInfo {
+  float integral;    // Sum of the solid-angle-weighted radiance, normalizes the PDFs
+  float average;     // Average CIE luminance, to drive the tonemapping
+  int   smallCount;  // Below-average texels; allocates the front of the partition table
+  int   largeAlloc;  // Allocates the back of the partition table, ends at smallCount
+};
+
+// #HdrBuild : push constant of the builder kernels
+struct HdrBuildState {
+  ivec2 hdrSize;
+  int   segment;  // Scanned segment of the scratch buffer: 0 - deficits, 1 - excesses
+};
+
 // Tonemapper used in post.frag
 struct Tonemapper {
   float brightness;
@@ -244,8 +371,9 @@ struct Tonemapper {
   float zoom;
   vec2  renderingRatio;
   int   autoExposure;
-  float Ywhite;  // Burning white
-  float key;     // Log-average luminance
+  float Ywhite;   // Burning white
+  float key;      // Log-average luminance
+  int   upscale;  // #DynRes : filtered reconstruction of the scaled render
 };
 
 struct SunAndSky {
@@ -37,21 +37,46 @@
 layout(set = S_ACCEL, binding = eTlas)					uniform accelerationStructureEXT topLevelAS;
 //
 layout(set = S_OUT,   binding = eStore)					uniform image2D			resultImage;
+layout(set = S_OUT,   binding = eMoments)				uniform image2D			momentsImage;
+layout(set = S_OUT,   binding = eStats)					buffer _OutputStats		{ uint convergedCount; };
+layout(set = S_OUT,   binding = eDenoiseRGB)			buffer _DenoiseRGB		{ vec4 denoiseRGB[]; };
+layout(set = S_OUT,   binding = eDenoiseAlbedo)			buffer _DenoiseAlbedo	{ vec4 denoiseAlbedo[]; };
+layout(set = S_OUT,   binding = eDenoiseNormal)			buffer _DenoiseNormal	{ vec4 denoiseNormal[]; };
+layout(set = S_OUT,   binding = eDenoiseFlow)			buffer _DenoiseFlow		{ vec2 denoiseFlow[]; };
+layout(set = S_OUT,   binding = eReproject)				uniform image2D			reprojImage;
+layout(set = S_OUT,   binding = eHistory)				uniform image2D			historyImage;
+layout(set = S_OUT,   binding = eResidual)				uniform image2D			residualImage;  // #HalfPrec
 //
 layout(set = S_SCENE, binding = eInstData,	scalar)     buffer _InstanceInfo	{ InstanceData geoInfo[]; };
 layout(set = S_SCENE, binding = eCamera,	scalar)		uniform _SceneCamera	{ SceneCamera sceneCamera; };
 layout(set = S_SCENE, binding = eMaterials,	scalar)		buffer _MaterialBuffer	{ GltfShadeMaterial materials[]; };
 layout(set = S_SCENE, binding = eLights,	scalar)		buffer _Lights			{ Light lights[]; };
+layout(set = S_SCENE, binding = eLightAccel, scalar)	buffer _LightAccel		{ LightAccel lightAccel[]; };  // #LightAccel
+layout(set = S_SCENE, binding = eViews,		scalar)		buffer _SceneViews		{ SceneView views[]; };  // #MultiView
 layout(set = S_SCENE, binding = eTextures	      )		uniform sampler2D		texturesMap[]; 
 //
 layout(set = S_ENV, binding = eSunSky,		scalar)		uniform _SSBuffer		{ SunAndSky _sunAndSky; };
 layout(set = S_ENV, binding = eHdr)						uniform sampler2D		environmentTexture;
 layout(set = S_ENV, binding = eImpSamples,  scalar)		buffer _EnvAccel		{ EnvAccel envSamplingData[]; };
+layout(set = S_ENV, binding = eRayStats,	scalar)		buffer _RayStats		{ RayStats rayStats; };
 
 layout(buffer_reference, scalar) buffer Vertices { VertexAttributes v[]; };
 layout(buffer_reference, scalar) buffer Indices	 { uvec3 i[];            };
 
   // clang-format on
 
+// #Stats : specialized at pipeline creation; the counter atomics compile out when 0
+layout(constant_id = 0) const int RAY_STATISTICS = 0;
+
+// #Variants : specialized at pipeline creation. With DEBUG_FEATURES 0 the debug outputs and
+// the heatmap clock instrumentation compile out; PBR_MODE folds the BRDF model branch
+// (0-Disney, 1-Gltf) instead of testing rtxState.pbrMode per event.
+layout(constant_id = 1) const int DEBUG_FEATURES = 1;
+layout(constant_id = 2) const int PBR_MODE       = 0;
+
+// #HalfPrec : the accumulation target is RGBA16F and the running mean is error-compensated
+// through the residual image (see AccumulateCompensated in common.glsl)
+layout(constant_id = 3) const int HALF_PRECISION = 0;
+
 
 #endif  // LAYOUTS_GLSL
@@ -39,7 +39,8 @@
 //-----------------------------------------------------------------------
 vec3 Eval(in State state, in vec3 V, in vec3 N, in vec3 L, inout float pdf)
 {
-  if(rtxState.pbrMode == 0)
+  // #Variants : PBR_MODE is a specialization constant, only one model survives compilation
+  if(PBR_MODE == 0)
     return DisneyEval(state, V, N, L, pdf);
   else
     return PbrEval(state, V, N, L, pdf);
@@ -49,7 +50,7 @@ vec3 Eval(in State state, in vec3 V, in vec3 N, in vec3 L, inout float pdf)
 //-----------------------------------------------------------------------
 vec3 Sample(in State state, in vec3 V, in vec3 N, inout vec3 L, inout float pdf, inout RngStateType seed)
 {
-  if(rtxState.pbrMode == 0)
+  if(PBR_MODE == 0)
     return DisneySample(state, V, N, L, pdf, seed);
   else
     return PbrSample(state, V, N, L, pdf, seed);
@@ -122,17 +123,19 @@ VisibilityContribution DirectLight(in Ray r, in State state)
   // Note: see also miss shader
   float p_select_light = rtxState.hdrMultiplier > 0.0f ? 0.5f : 1.0f;
 
-  // in general, you would select the light depending on the importance of it
-  // e.g. by incorporating their luminance
-
   // Point lights
   if(sceneCamera.nbLights != 0 && rand(prd.seed) <= p_select_light)
   {
     isLight = true;
 
-    // randomly select one of the lights
-    int   light_index = int(min(rand(prd.seed) * sceneCamera.nbLights, sceneCamera.nbLights));
-    Light light       = lights[light_index];
+    // #LightAccel : select a light proportionally to its estimated power through the alias
+    // table instead of uniformly. The stored pdf is expressed relative to the uniform pick
+    // below, so a scene of equal-power lights reproduces the uniform estimator exactly.
+    int        light_index = min(int(rand(prd.seed) * sceneCamera.nbLights), sceneCamera.nbLights - 1);
+    LightAccel la          = lightAccel[light_index];
+    if(rand(prd.seed) > la.q)
+      light_index = int(la.alias);
+    Light light = lights[light_index];
 
     vec3  pointToLight     = -light.direction;
     float rangeAttenuation = 1.0;
@@ -159,7 +162,7 @@ VisibilityContribution DirectLight(in Ray r, in State state)
 
     lightContrib = intensity;
     lightDir     = normalize(pointToLight);
-    lightPdf     = 1.0;
+    lightPdf     = lightAccel[light_index].pdf * float(sceneCamera.nbLights);  // #LightAccel : relative to uniform
   }
   // Environment Light
   else
@@ -198,6 +201,12 @@ VisibilityContribution DirectLight(in Ray r, in State state)
 }
 
 
+// #Denoise : first-hit values of the last sample, guide layers for the Optix denoiser
+vec3  g_denoiseAlbedo   = vec3(0);
+vec3  g_denoiseNormal   = vec3(0);
+vec3  g_denoisePosition = vec3(0);  // World position, for the motion vectors
+float g_denoiseHit      = 0;        // 0 when the primary ray left the scene
+
 //-----------------------------------------------------------------------
 //-----------------------------------------------------------------------
 vec3 PathTrace(Ray r)
@@ -208,12 +217,21 @@ vec3 PathTrace(Ray r)
 
   for(int depth = 0; depth < rtxState.maxDepth; depth++)
   {
+    // #Stats : one path segment traced
+    if(RAY_STATISTICS == 1)
+    {
+      if(depth == 0)
+        atomicAdd(rayStats.primaryRays, 1);
+      else
+        atomicAdd(rayStats.bounceRays, 1);
+    }
+
     ClosestHit(r);
 
     // Hitting the environment
     if(prd.hitT == INFINITY)
     {
-      if(rtxState.debugging_mode != eNoDebug)
+      if(DEBUG_FEATURES == 1 && rtxState.debugging_mode != eNoDebug)
       {
         if(depth != rtxState.maxDepth - 1)
           return vec3(0);
@@ -233,6 +251,15 @@ vec3 PathTrace(Ray r)
         vec2 uv = GetSphericalUv(r.direction);  // See sampling.glsl
         env     = texture(environmentTexture, uv).rgb;
       }
+
+      // #Denoise : the environment is its own albedo, there is no normal nor motion
+      if(depth == 0)
+      {
+        g_denoiseAlbedo = env * rtxState.hdrMultiplier;
+        g_denoiseNormal = vec3(0);
+        g_denoiseHit    = 0;
+      }
+
       // Done sampling return
       return radiance + (env * rtxState.hdrMultiplier * throughput);
     }
@@ -261,8 +288,17 @@ vec3 PathTrace(Ray r)
     // Color at vertices
     state.mat.albedo *= sstate.color;
 
+    // #Denoise : the primary hit feeds the guide layers
+    if(depth == 0)
+    {
+      g_denoiseAlbedo   = state.mat.albedo;
+      g_denoiseNormal   = state.normal;
+      g_denoisePosition = sstate.position;
+      g_denoiseHit      = 1;
+    }
+
     // Debugging info
-    if(rtxState.debugging_mode != eNoDebug && rtxState.debugging_mode < eRadiance)
+    if(DEBUG_FEATURES == 1 && rtxState.debugging_mode != eNoDebug && rtxState.debugging_mode < eRadiance)
       return DebugInfo(state);
 
     // KHR_materials_unlit
@@ -306,7 +342,7 @@ vec3 PathTrace(Ray r)
     }
 
     // Debugging info
-    if(rtxState.debugging_mode != eNoDebug && (depth == rtxState.maxDepth - 1))
+    if(DEBUG_FEATURES == 1 && rtxState.debugging_mode != eNoDebug && (depth == rtxState.maxDepth - 1))
     {
       if(rtxState.debugging_mode == eRadiance)
         return vcontrib.radiance;
@@ -332,6 +368,8 @@ vec3 PathTrace(Ray r)
     if(vcontrib.visible == true)
     {
       // Shoot shadow ray up to the light (1e32 == environement)
+      if(RAY_STATISTICS == 1)
+        atomicAdd(rayStats.shadowRays, 1);
       Ray  shadowRay = Ray(r.origin, vcontrib.lightDir);
       bool inShadow  = AnyHit(shadowRay, vcontrib.lightDist);
       if(!inShadow)
@@ -362,6 +400,21 @@ vec3 samplePixel(ivec2 imageCoords, ivec2 sizeImage)
   // Subpixel jitter: send the ray through a different position inside the pixel each time, to provide antialiasing.
   vec2 subpixel_jitter = rtxState.frame == 0 ? vec2(0.5f, 0.5f) : vec2(rand(prd.seed), rand(prd.seed));
 
+  // #MultiView : the frame is an atlas of view tiles; remap the pixel into its tile and use
+  // that view's matrices, everything else of the path is unchanged
+  mat4 viewInverse = sceneCamera.viewInverse;
+  mat4 projInverse = sceneCamera.projInverse;
+  if(sceneCamera.nbViews > 1)
+  {
+    ivec2 viewSize = sizeImage / sceneCamera.viewGrid;
+    ivec2 cell     = min(imageCoords / viewSize, sceneCamera.viewGrid - 1);
+    int   view     = min(cell.y * sceneCamera.viewGrid.x + cell.x, sceneCamera.nbViews - 1);
+    viewInverse    = views[view].viewInverse;
+    projInverse    = views[view].projInverse;
+    imageCoords -= cell * viewSize;
+    sizeImage = viewSize;
+  }
+
   // Compute sampling position between [-1 .. 1]
   const vec2 pixelCenter = vec2(imageCoords) + subpixel_jitter;
   const vec2 inUV        = pixelCenter / vec2(sizeImage.xy);
@@ -384,17 +437,17 @@ vec3 samplePixel(ivec2 imageCoords, ivec2 sizeImage)
   // if (length(d2)> 1 )
   //   return vec3(0.1,0.3,1.0);
   // Compute ray origin and direction
-  vec4 origin    = sceneCamera.viewInverse * vec4(0, 0, 0, 1);
-  vec4 target    = sceneCamera.projInverse * vec4(d.x, d.y, 1, 1);
-  // vec4 target    = sceneCamera.projInverse * vec4(d2.x, d2.y, 1, 1);
-  vec4 direction = sceneCamera.viewInverse * vec4(normalize(target.xyz), 0);
+  vec4 origin    = viewInverse * vec4(0, 0, 0, 1);
+  vec4 target    = projInverse * vec4(d.x, d.y, 1, 1);
+  // vec4 target    = projInverse * vec4(d2.x, d2.y, 1, 1);
+  vec4 direction = viewInverse * vec4(normalize(target.xyz), 0);
 
   // Depth-of-Field
   vec3  focalPoint        = sceneCamera.focalDist * direction.xyz;
   float cam_r1            = rand(prd.seed) * M_TWO_PI;
   float cam_r2            = rand(prd.seed) * sceneCamera.aperture;
-  vec4  cam_right         = sceneCamera.viewInverse * vec4(1, 0, 0, 0);
-  vec4  cam_up            = sceneCamera.viewInverse * vec4(0, 1, 0, 0);
+  vec4  cam_right         = viewInverse * vec4(1, 0, 0, 0);
+  vec4  cam_up            = viewInverse * vec4(0, 1, 0, 0);
   vec3  randomAperturePos = (cos(cam_r1) * cam_right.xyz + sin(cam_r1) * cam_up.xyz) * sqrt(cam_r2);
   vec3  finalRayDir       = normalize(focalPoint - randomAperturePos);
 
@@ -412,3 +465,36 @@ vec3 samplePixel(ivec2 imageCoords, ivec2 sizeImage)
 
   return radiance;
 }
+
+//-----------------------------------------------------------------------
+// #Reproject : after a camera move, warp the last completed frame and keep it where the
+// primary surface is the same; pixels failing the disocclusion test restart fresh
+//
+vec3 ReprojectHistory(vec3 pixelColor)
+{
+  if(g_denoiseHit != 1)
+    return pixelColor;  // The environment has no position to warp
+
+  vec4  prevClip = sceneCamera.prevViewProj * vec4(g_denoisePosition, 1);
+  vec2  prevUv   = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+  ivec2 prevCrd  = ivec2(prevUv * vec2(rtxState.size));
+  if(prevClip.w <= 0 || any(lessThan(prevCrd, ivec2(0))) || any(greaterThanEqual(prevCrd, rtxState.size)))
+    return pixelColor;  // Was outside the previous frame
+
+  vec4 history = imageLoad(historyImage, prevCrd);
+  if(history.a <= 0 || abs(prevClip.w - history.a) > REPROJECT_DEPTH_TOLERANCE * history.a)
+    return pixelColor;  // Disoccluded, the history shows another surface
+
+  // The warped sample stands in for a few accumulated frames
+  return mix(history.rgb, pixelColor, 1.0f / float(REPROJECT_SEED_FRAMES + 1));
+}
+
+//-----------------------------------------------------------------------
+// #Reproject : color and primary depth of this frame; the host copies it to the history
+// image once the pass is done, so reads never race the writes
+//
+void StoreReprojection(ivec2 imageCoords, vec3 color)
+{
+  float depth = g_denoiseHit == 1 ? (sceneCamera.viewProj * vec4(g_denoisePosition, 1)).w : 0;
+  imageStore(reprojImage, imageCoords, vec4(color, depth));
+}
@@ -95,10 +95,50 @@ vec3 toneLocalExposure(vec3 RGB, float logAvgLum)
 }
 
 
+// #DynRes : Catmull-Rom reconstruction of the scaled render (9 taps on the bilinear grid).
+// The path tracers jitter the primary rays inside each pixel every frame, so the scaled
+// accumulation integrates sub-pixel detail over time; the sharper kernel recovers edges that
+// the plain bilinear fetch of the zoomed image smears away.
+vec4 upscaleFetch(vec2 uv)
+{
+  vec2 texSize   = vec2(textureSize(inImage, 0));
+  vec2 samplePos = uv * texSize;
+  vec2 texPos1   = floor(samplePos - 0.5) + 0.5;
+  vec2 f         = samplePos - texPos1;
+
+  vec2 w0  = f * (-0.5 + f * (1.0 - 0.5 * f));
+  vec2 w1  = 1.0 + f * f * (-2.5 + 1.5 * f);
+  vec2 w2  = f * (0.5 + f * (2.0 - 1.5 * f));
+  vec2 w3  = f * f * (-0.5 + 0.5 * f);
+  vec2 w12 = w1 + w2;
+
+  vec2 tc0  = (texPos1 - 1.0) / texSize;
+  vec2 tc3  = (texPos1 + 2.0) / texSize;
+  vec2 tc12 = (texPos1 + w2 / w12) / texSize;
+
+  // The taps must not read outside the rendered region of the accumulation image
+  vec2 uvMax = tm.zoom / tm.renderingRatio - 0.5 / texSize;
+  tc0        = min(tc0, uvMax);
+  tc3        = min(tc3, uvMax);
+  tc12       = min(tc12, uvMax);
+
+  vec4 color = vec4(0);
+  color += texture(inImage, vec2(tc0.x, tc0.y)) * w0.x * w0.y;
+  color += texture(inImage, vec2(tc12.x, tc0.y)) * w12.x * w0.y;
+  color += texture(inImage, vec2(tc3.x, tc0.y)) * w3.x * w0.y;
+  color += texture(inImage, vec2(tc0.x, tc12.y)) * w0.x * w12.y;
+  color += texture(inImage, vec2(tc12.x, tc12.y)) * w12.x * w12.y;
+  color += texture(inImage, vec2(tc3.x, tc12.y)) * w3.x * w12.y;
+  color += texture(inImage, vec2(tc0.x, tc3.y)) * w0.x * w3.y;
+  color += texture(inImage, vec2(tc12.x, tc3.y)) * w12.x * w3.y;
+  color += texture(inImage, vec2(tc3.x, tc3.y)) * w3.x * w3.y;
+  return max(color, vec4(0));
+}
+
 void main()
 {
-  // Raw result of ray tracing
-  vec4 hdr = texture(inImage, uvCoords * tm.zoom).rgba;
+  // Raw result of ray tracing, reconstructed when rendered below display resolution (#DynRes)
+  vec4 hdr = tm.upscale == 1 ? upscaleFetch(uvCoords * tm.zoom) : texture(inImage, uvCoords * tm.zoom).rgba;
 
   if(((tm.autoExposure >> 0) & 1) == 1)
   {
@@ -31,6 +31,10 @@
 //----------------------------------------------------------
 bool HitTest(in rayQueryEXT rayQuery, in Ray r)
 {
+  // #Stats : equivalent of an anyhit shader invocation
+  if(RAY_STATISTICS == 1)
+    atomicAdd(rayStats.anyHits, 1);
+
   int InstanceCustomIndexEXT = rayQueryGetIntersectionInstanceCustomIndexEXT(rayQuery, false);
   int PrimitiveID            = rayQueryGetIntersectionPrimitiveIndexEXT(rayQuery, false);
 
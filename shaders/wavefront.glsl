@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//-------------------------------------------------------------------------------------------------
+// #Wavefront : layout of the extra set and the ray queue helpers, shared by the generate,
+// trace and shade kernels (see wavefront.cpp).
+//
+// The path of a pixel lives at a fixed slot of the state buffer; the queues only carry pixel
+// indices, compacted with an atomic push. Two queues ping-pong with the bounce parity: the
+// kernels of depth d consume queue (d & 1) and shade pushes the surviving paths into the
+// other one. The headers are dispatch-indirect commands, so no ray count ever travels
+// through the host.
+
+#ifndef WAVEFRONT_GLSL
+#define WAVEFRONT_GLSL 1
+
+#include "host_device.h"
+
+// clang-format off
+layout(set = S_WF, binding = eWFPathStates, scalar)	buffer _WavePathStates	{ WavePathState pathStates[]; };
+layout(set = S_WF, binding = eWFQueues,		scalar)	buffer _WaveQueues
+{
+  WaveQueue waveQueue[2];
+  int       wfDepth;     // Current bounce, selects the queue pair (written by the host)
+  int       wfSample;    // Current sample of the frame (written by the host)
+  int       wfCapacity;  // Index slots per queue (the pixel count of the render size)
+  int       wfPad;
+  uint      waveIndex[];
+};
+layout(set = S_WF, binding = eWFInstances,	scalar)	buffer _WaveInstances	{ WaveInstance waveInstances[]; };
+// clang-format on
+
+//-----------------------------------------------------------------------
+// Appends a pixel to queue q and keeps the dispatch-indirect group count in sync
+//
+void WavePush(int q, uint pixel)
+{
+  uint slot = atomicAdd(waveQueue[q].count, 1);
+  atomicMax(waveQueue[q].groupsX, slot / WAVEFRONT_GROUP_SIZE + 1);
+  waveIndex[q * wfCapacity + slot] = pixel;
+}
+
+//-----------------------------------------------------------------------
+// The pixel this thread works on, or -1 when the thread is past the queue count
+//
+int WavePop(int q)
+{
+  uint idx = gl_GlobalInvocationID.x;
+  if(idx >= waveQueue[q].count)
+    return -1;
+  return int(waveIndex[q * wfCapacity + idx]);
+}
+
+#endif  // WAVEFRONT_GLSL
@@ -28,9 +28,12 @@
 
 #include "accelstruct.hpp"
 
+#include <algorithm>
 #include <ios>
 #include <sstream>
 
+#include "nvvk/buffers_vk.hpp"
+#include "nvvk/commands_vk.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "shaders/host_device.h"
 #include "tools.hpp"
@@ -45,18 +48,25 @@ void AccelStructure::setup(const VkDevice& device, const VkPhysicalDevice& physi
 }
 
 void AccelStructure::destroy() {
+  m_tlasInstances.clear();
+  m_pAlloc->destroy(m_tlasUpdateBuffer);
+  m_pAlloc->destroy(m_tlasUpdateScratch);
   m_rtBuilder.destroy();
+  for (auto& blas : m_blas) {
+    m_pAlloc->destroy(blas);
+  }
+  m_blas.clear();
+  m_memStats = {};
   vkDestroyDescriptorPool(m_device, m_rtDescPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_rtDescSetLayout, nullptr);
 }
 
-void AccelStructure::create(nvh::GltfScene& gltfScene, const std::vector<nvvk::Buffer>& vertex,
-                            const std::vector<nvvk::Buffer>& index) {
+void AccelStructure::create(nvh::GltfScene& gltfScene, const std::vector<InstanceData>& instData) {
   MilliTimer timer;
   LOGI("Create acceleration structure \n");
   destroy();  // reset
 
-  createBottomLevelAS(gltfScene, vertex, index);
+  createBottomLevelAS(gltfScene, instData);
   createTopLevelAS(gltfScene);
   createRtDescriptorSet();
   timer.print();
@@ -66,14 +76,10 @@ void AccelStructure::create(nvh::GltfScene& gltfScene, const std::vector<nvvk::B
 // Converting a GLTF primitive in the Raytracing Geometry used for the BLAS
 //
 nvvk::RaytracingBuilderKHR::BlasInput AccelStructure::primitiveToGeometry(const nvh::GltfPrimMesh& prim,
-                                                                          VkBuffer vertex, VkBuffer index) {
-  // Building part
-  VkBufferDeviceAddressInfo info{VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
-  info.buffer                   = vertex;
-  VkDeviceAddress vertexAddress = vkGetBufferDeviceAddress(m_device, &info);
-  info.buffer                   = index;
-  VkDeviceAddress indexAddress  = vkGetBufferDeviceAddress(m_device, &info);
-
+                                                                          VkDeviceAddress vertexAddress,
+                                                                          VkDeviceAddress indexAddress) {
+  // The addresses already point inside the packed vertex/index buffers (base + byte offset),
+  // so no per-primitive vkGetBufferDeviceAddress query is needed here.
   VkAccelerationStructureGeometryTrianglesDataKHR triangles{
     VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR};
   triangles.vertexFormat             = VK_FORMAT_R32G32B32_SFLOAT;
@@ -105,27 +111,141 @@ nvvk::RaytracingBuilderKHR::BlasInput AccelStructure::primitiveToGeometry(const
 //--------------------------------------------------------------------------------------------------
 //
 //
-void AccelStructure::createBottomLevelAS(nvh::GltfScene& gltfScene, const std::vector<nvvk::Buffer>& vertex,
-                                         const std::vector<nvvk::Buffer>& index) {
+void AccelStructure::createBottomLevelAS(nvh::GltfScene& gltfScene, const std::vector<InstanceData>& instData) {
   // BLAS - Storing each primitive in a geometry
   uint32_t                                           prim_idx{0};
   std::vector<nvvk::RaytracingBuilderKHR::BlasInput> allBlas;
   allBlas.reserve(gltfScene.m_primMeshes.size());
   for (nvh::GltfPrimMesh& primMesh : gltfScene.m_primMeshes) {
-    auto geo = primitiveToGeometry(primMesh, vertex[prim_idx].buffer, index[prim_idx].buffer);
+    auto geo = primitiveToGeometry(primMesh, instData[prim_idx].vertexAddress, instData[prim_idx].indexAddress);
     allBlas.push_back({geo});
     prim_idx++;
   }
-  LOGI(" BLAS(%d)", allBlas.size());
-  m_rtBuilder.buildBlas(allBlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
-                                   VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR);
+  auto nbBlas = static_cast<uint32_t>(allBlas.size());
+  LOGI(" BLAS(%d)", nbBlas);
+
+  VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR |
+                                               VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+
+  // Query the memory requirement of each BLAS and the largest scratch needed to build any of them
+  std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos(nbBlas);
+  std::vector<VkAccelerationStructureBuildSizesInfoKHR>    sizeInfos(nbBlas);
+  VkDeviceSize                                             maxScratch{0};
+  m_memStats = {};
+  for (uint32_t idx = 0; idx < nbBlas; idx++) {
+    buildInfos[idx]               = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+    buildInfos[idx].type          = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+    buildInfos[idx].mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    buildInfos[idx].flags         = flags;
+    buildInfos[idx].geometryCount = static_cast<uint32_t>(allBlas[idx].asGeometry.size());
+    buildInfos[idx].pGeometries   = allBlas[idx].asGeometry.data();
+
+    std::vector<uint32_t> primCounts(allBlas[idx].asBuildOffsetInfo.size());
+    for (size_t geo = 0; geo < primCounts.size(); geo++)
+      primCounts[geo] = allBlas[idx].asBuildOffsetInfo[geo].primitiveCount;
+
+    sizeInfos[idx] = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+    vkGetAccelerationStructureBuildSizesKHR(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                                            &buildInfos[idx], primCounts.data(), &sizeInfos[idx]);
+    maxScratch = std::max(maxScratch, sizeInfos[idx].buildScratchSize);
+    m_memStats.blasOriginalSize.push_back(sizeInfos[idx].accelerationStructureSize);
+    m_memStats.totalOriginalSize += sizeInfos[idx].accelerationStructureSize;
+  }
+
+  // One scratch buffer, reused by all builds (they are serialized with a barrier)
+  nvvk::Buffer scratchBuffer =
+    m_pAlloc->createBuffer(maxScratch, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+  VkDeviceAddress scratchAddress = nvvk::getBufferDeviceAddress(m_device, scratchBuffer.buffer);
+
+  // Query pool returning the real (compacted) size of each BLAS
+  VkQueryPoolCreateInfo qpci{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  qpci.queryCount = nbBlas;
+  qpci.queryType  = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+  VkQueryPool queryPool;
+  vkCreateQueryPool(m_device, &qpci, nullptr, &queryPool);
+
+  // Building all BLAS at their original size
+  nvvk::CommandPool           genCmdBuf(m_device, m_queueIndex);
+  std::vector<nvvk::AccelKHR> asOriginal(nbBlas);
+  {
+    VkCommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
+    vkCmdResetQueryPool(cmdBuf, queryPool, 0, nbBlas);
+    for (uint32_t idx = 0; idx < nbBlas; idx++) {
+      VkAccelerationStructureCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+      createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+      createInfo.size = sizeInfos[idx].accelerationStructureSize;
+      asOriginal[idx] = m_pAlloc->createAcceleration(createInfo);
+
+      buildInfos[idx].dstAccelerationStructure  = asOriginal[idx].accel;
+      buildInfos[idx].scratchData.deviceAddress = scratchAddress;
+
+      const VkAccelerationStructureBuildRangeInfoKHR* rangeInfo = allBlas[idx].asBuildOffsetInfo.data();
+      vkCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildInfos[idx], &rangeInfo);
+
+      // The builds run one after the other, the scratch buffer is reused
+      VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+      barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+      barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+      vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                           VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0,
+                           nullptr);
+
+      vkCmdWriteAccelerationStructuresPropertiesKHR(cmdBuf, 1, &buildInfos[idx].dstAccelerationStructure,
+                                                    VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, queryPool,
+                                                    idx);
+    }
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  // Compaction pass: copy each BLAS in a buffer of its compacted size and release the original
+  std::vector<VkDeviceSize> compactSizes(nbBlas);
+  vkGetQueryPoolResults(m_device, queryPool, 0, nbBlas, nbBlas * sizeof(VkDeviceSize), compactSizes.data(),
+                        sizeof(VkDeviceSize), VK_QUERY_RESULT_WAIT_BIT);
+  m_blas.resize(nbBlas);
+  {
+    VkCommandBuffer cmdBuf = genCmdBuf.createCommandBuffer();
+    for (uint32_t idx = 0; idx < nbBlas; idx++) {
+      VkAccelerationStructureCreateInfoKHR createInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR};
+      createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+      createInfo.size = compactSizes[idx];
+      m_blas[idx]     = m_pAlloc->createAcceleration(createInfo);
+
+      VkCopyAccelerationStructureInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+      copyInfo.src  = asOriginal[idx].accel;
+      copyInfo.dst  = m_blas[idx].accel;
+      copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+      vkCmdCopyAccelerationStructureKHR(cmdBuf, &copyInfo);
+
+      m_memStats.blasCompactSize.push_back(compactSizes[idx]);
+      m_memStats.totalCompactSize += compactSizes[idx];
+    }
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  for (auto& blas : asOriginal)
+    m_pAlloc->destroy(blas);
+  m_pAlloc->destroy(scratchBuffer);
+  vkDestroyQueryPool(m_device, queryPool, nullptr);
+
+  LOGI(" BLAS compaction: %llu MB -> %llu MB\n", m_memStats.totalOriginalSize >> 20, m_memStats.totalCompactSize >> 20);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Device address of a BLAS, used as acceleration structure reference in the TLAS instances
+//
+VkDeviceAddress AccelStructure::getBlasDeviceAddress(uint32_t blasId) {
+  VkAccelerationStructureDeviceAddressInfoKHR addressInfo{
+    VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR};
+  addressInfo.accelerationStructure = m_blas[blasId].accel;
+  return vkGetAccelerationStructureDeviceAddressKHR(m_device, &addressInfo);
 }
 
 //--------------------------------------------------------------------------------------------------
 //
 //
 void AccelStructure::createTopLevelAS(nvh::GltfScene& gltfScene) {
-  std::vector<VkAccelerationStructureInstanceKHR> tlas;
+  std::vector<VkAccelerationStructureInstanceKHR>& tlas = m_tlasInstances;
+  tlas.clear();
   tlas.reserve(gltfScene.m_nodes.size());
 
   for (auto& node : gltfScene.m_nodes) {
@@ -144,14 +264,87 @@ void AccelStructure::createTopLevelAS(nvh::GltfScene& gltfScene) {
     VkAccelerationStructureInstanceKHR rayInst{};
     rayInst.transform                      = nvvk::toTransformMatrixKHR(node.worldMatrix);
     rayInst.instanceCustomIndex            = node.primMesh;  // gl_InstanceCustomIndexEXT: to find which primitive
-    rayInst.accelerationStructureReference = m_rtBuilder.getBlasDeviceAddress(node.primMesh);
+    rayInst.accelerationStructureReference = getBlasDeviceAddress(node.primMesh);
     rayInst.flags                          = flags;
     rayInst.instanceShaderBindingTableRecordOffset = 0;  // We will use the same hit group for all objects
     rayInst.mask                                   = 0xFF;
     tlas.emplace_back(rayInst);
   }
   LOGI(" TLAS(%d)", tlas.size());
-  m_rtBuilder.buildTlas(tlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR);
+  // ALLOW_UPDATE so the TLAS can later be refit by updateTopLevelAS
+  m_rtBuilder.buildTlas(tlas, VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+                                | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Refitting the TLAS with new node transforms, without rebuilding it or touching the
+// descriptor set (the acceleration structure handle does not change on update).
+// The refit is recorded into the frame's command buffer, ahead of the trace: queue order plus
+// the barriers below make the in-flight frames finish reading the TLAS before it is rewritten
+// in place, and the trace of this frame waits for the update.
+//
+void AccelStructure::updateTopLevelAS(const VkCommandBuffer& cmdBuf, const std::vector<nvmath::mat4f>& nodeMatrices) {
+  assert(nodeMatrices.size() == m_tlasInstances.size());
+  for (size_t idx = 0; idx < nodeMatrices.size(); idx++)
+    m_tlasInstances[idx].transform = nvvk::toTransformMatrixKHR(nodeMatrices[idx]);
+
+  const uint32_t     nbInstances = static_cast<uint32_t>(m_tlasInstances.size());
+  const VkDeviceSize instSize    = nbInstances * sizeof(VkAccelerationStructureInstanceKHR);
+
+  VkAccelerationStructureGeometryKHR geometry{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR};
+  geometry.geometryType          = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+  geometry.geometry.instances    = {VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR};
+
+  VkAccelerationStructureBuildGeometryInfoKHR buildInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR};
+  buildInfo.type  = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+  buildInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR
+                    | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+  buildInfo.mode          = VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+  buildInfo.geometryCount = 1;
+  buildInfo.pGeometries   = &geometry;
+
+  // First refit of this scene: the device copy of the instances and the update scratch
+  if (m_tlasUpdateBuffer.buffer == VK_NULL_HANDLE) {
+    m_tlasUpdateBuffer = m_pAlloc->createBuffer(instSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                                                            | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                            | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+    NAME_VK(m_tlasUpdateBuffer.buffer);
+
+    VkAccelerationStructureBuildSizesInfoKHR sizeInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR};
+    vkGetAccelerationStructureBuildSizesKHR(m_device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildInfo,
+                                            &nbInstances, &sizeInfo);
+    m_tlasUpdateScratch = m_pAlloc->createBuffer(sizeInfo.updateScratchSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                                                                               | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    NAME_VK(m_tlasUpdateScratch.buffer);
+  }
+
+  m_pAlloc->getStaging()->cmdToBuffer(cmdBuf, m_tlasUpdateBuffer.buffer, 0, instSize, m_tlasInstances.data());
+
+  // The build waits for the instance upload and for the tracing of earlier frames, which read
+  // the TLAS this update rewrites in place
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR
+                         | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+  geometry.geometry.instances.data.deviceAddress = nvvk::getBufferDeviceAddress(m_device, m_tlasUpdateBuffer.buffer);
+  buildInfo.srcAccelerationStructure             = m_rtBuilder.getAccelerationStructure();
+  buildInfo.dstAccelerationStructure             = buildInfo.srcAccelerationStructure;
+  buildInfo.scratchData.deviceAddress            = nvvk::getBufferDeviceAddress(m_device, m_tlasUpdateScratch.buffer);
+
+  VkAccelerationStructureBuildRangeInfoKHR        range{nbInstances, 0, 0, 0};
+  const VkAccelerationStructureBuildRangeInfoKHR* pRange = &range;
+  vkCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildInfo, &pRange);
+
+  // The trace of this frame waits for the refit
+  barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+  barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
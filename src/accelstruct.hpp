@@ -22,27 +22,43 @@
 #include "nvvk/descriptorsets_vk.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "shaders/host_device.h"
 
 /*
 
  This is for uploading a glTF scene to an acceleration structure.
  - setup as usual
- - create passing the glTF scene and the buffer of vertices and indices pre-constructed
+ - create passing the glTF scene and the per-primitive device addresses in the packed
+   vertex/index buffers (InstanceData, see Scene::getInstData)
  - retrieve the TLAS with getTlas
  - get the descriptor set and layout
 
 */
 class AccelStructure {
 public:
+  // Device memory occupied by the acceleration structures, filled during create()
+  struct AsMemoryStats {
+    VkDeviceSize              totalOriginalSize{0};  // All BLAS, as built
+    VkDeviceSize              totalCompactSize{0};   // All BLAS, after the compaction pass
+    std::vector<VkDeviceSize> blasOriginalSize;
+    std::vector<VkDeviceSize> blasCompactSize;
+  };
+
   void setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex,
              nvvk::ResourceAllocator* allocator);
   void destroy();
-  void create(nvh::GltfScene& gltfScene, const std::vector<nvvk::Buffer>& vertex,
-              const std::vector<nvvk::Buffer>& index);
+  void create(nvh::GltfScene& gltfScene, const std::vector<InstanceData>& instData);
+
+  // Refitting the TLAS with new node transforms (one matrix per glTF node, same order as
+  // gltfScene.m_nodes). Recorded into the given command buffer, ahead of the trace using it.
+  void updateTopLevelAS(const VkCommandBuffer& cmdBuf, const std::vector<nvmath::mat4f>& nodeMatrices);
 
   VkAccelerationStructureKHR getTlas() {
     return m_rtBuilder.getAccelerationStructure();
   }
+  const AsMemoryStats& getMemoryStats() const {
+    return m_memStats;
+  }
   VkDescriptorSetLayout getDescLayout() {
     return m_rtDescSetLayout;
   }
@@ -51,20 +67,27 @@ public:
   }
 
 private:
-  nvvk::RaytracingBuilderKHR::BlasInput primitiveToGeometry(const nvh::GltfPrimMesh& prim, VkBuffer vertex,
-                                                            VkBuffer index);
-  void createBottomLevelAS(nvh::GltfScene& gltfScene, const std::vector<nvvk::Buffer>& vertex,
-                           const std::vector<nvvk::Buffer>& index);
+  nvvk::RaytracingBuilderKHR::BlasInput primitiveToGeometry(const nvh::GltfPrimMesh& prim,
+                                                            VkDeviceAddress vertexAddress, VkDeviceAddress indexAddress);
+  void createBottomLevelAS(nvh::GltfScene& gltfScene, const std::vector<InstanceData>& instData);
   void createTopLevelAS(nvh::GltfScene& gltfScene);
   void createRtDescriptorSet();
 
+  VkDeviceAddress getBlasDeviceAddress(uint32_t blasId);
+
   // Setup
   nvvk::ResourceAllocator* m_pAlloc{nullptr};  // Allocator for buffer, images, acceleration structures
   nvvk::DebugUtil          m_debug;            // Utility to name objects
   VkDevice                 m_device{nullptr};
   uint32_t                 m_queueIndex{0};
 
-  nvvk::RaytracingBuilderKHR m_rtBuilder;
+  nvvk::RaytracingBuilderKHR  m_rtBuilder;  // Used for the TLAS
+  std::vector<nvvk::AccelKHR> m_blas;       // Compacted bottom-level AS, one per primitive mesh
+  AsMemoryStats               m_memStats;
+
+  std::vector<VkAccelerationStructureInstanceKHR> m_tlasInstances;     // Kept on the host for refitting
+  nvvk::Buffer                                    m_tlasUpdateBuffer;  // Device copy of the instances, per refit
+  nvvk::Buffer                                    m_tlasUpdateScratch;
 
   VkDescriptorPool      m_rtDescPool{VK_NULL_HANDLE};
   VkDescriptorSetLayout m_rtDescSetLayout{VK_NULL_HANDLE};
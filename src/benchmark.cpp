@@ -0,0 +1,245 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ *  #Bench : reproducible performance suite with scripted camera orbits (see header)
+ */
+
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "nvh/cameramanipulator.hpp"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/context_vk.hpp"
+#include "rayquery.hpp"
+#include "rtx_pipeline.hpp"
+#include "simulator.hpp"
+#include "tools.hpp"
+
+extern std::vector<std::string> defaultSearchPaths;
+
+// One scene of the suite and its throughput gate (0 reports only)
+struct BenchScene {
+  std::string file;
+  float       minMrays{0.f};
+};
+
+//--------------------------------------------------------------------------------------------------
+// Suite file: one scene per line, "<scene.gltf> [min Mrays/s]"; '#' starts a comment
+//
+static std::vector<BenchScene> parseSuite(const std::string& suiteFile) {
+  std::vector<BenchScene> scenes;
+  std::ifstream           file(suiteFile);
+  std::string             line;
+  while (std::getline(file, line)) {
+    std::istringstream ss(line);
+    BenchScene         bs;
+    if (!(ss >> bs.file) || bs.file[0] == '#')
+      continue;
+    ss >> bs.minMrays;
+    scenes.push_back(bs);
+  }
+  return scenes;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Measures one renderer on the loaded scene: wall-clock first frame (includes the pipeline
+// creation), then the fixed orbit. Throughput is the #Stats ray total of a frame against the
+// "Render" GPU timer; the counters of frame N are read back while recording N+1, so the first
+// frame is excluded and the remaining ones are the steady state.
+//
+static bool benchRenderer(Simulator& sim, Simulator::RndMethod method, const char* name, float minMrays,
+                          int frames, std::ofstream& out, bool firstRow) {
+  sim.createRender(method);
+
+  // #Stats : compile the ray counters into the pipeline
+  if (auto rtx = dynamic_cast<RtxPipeline*>(sim.m_pRender[method]))
+    rtx->useRayStatistics(true);
+  if (auto rq = dynamic_cast<RayQuery*>(sim.m_pRender[method]))
+    rq->useRayStatistics(true);
+
+  nvvk::ProfilerVK profiler;
+  profiler.init(sim.getDevice(), sim.getPhysicalDevice(), sim.getQueueFamily());
+
+  // The orbit of the scene bounds; identical every run, and so are the shader seeds (pixel and
+  // frame number, both fixed here)
+  const auto&         dims   = sim.m_scene.getScene().m_dimensions;
+  const nvmath::vec3f center = (dims.min + dims.max) * 0.5f;
+  const float         radius = std::max(0.75f * nvmath::length(dims.max - dims.min), 0.01f);
+
+  sim.resetFrame();
+  double            firstFrameMs{0};
+  double            totalRays{0};
+  nvvk::CommandPool cmdPool(sim.getDevice(), sim.getQueueFamily());
+  for (int f = 0; f < frames; f++) {
+    const float angle = 2.f * nvmath::nv_pi * static_cast<float>(f) / static_cast<float>(frames);
+    CameraManip.setLookat(center + radius * nvmath::vec3f(sinf(angle), 0.35f, cosf(angle)), center, {0, 1, 0});
+
+    MilliTimer frameTimer;
+    auto       cmdBuf = cmdPool.createCommandBuffer();
+    profiler.beginFrame();
+
+    sim.m_rtxState.frame = f;
+    sim.updateUniformBuffer(cmdBuf);
+    sim.renderScene(cmdBuf, profiler);
+
+    profiler.endFrame();
+    cmdPool.submitAndWait(cmdBuf);
+
+    if (f == 0)
+      firstFrameMs = frameTimer.elapsed();
+    else  // m_rayStats now holds the counters of the previous frame
+      totalRays += double(sim.m_rayStats.primaryRays) + sim.m_rayStats.bounceRays + sim.m_rayStats.shadowRays;
+  }
+
+  nvh::Profiler::TimerInfo info{};
+  profiler.getTimerInfo("Render", info);
+  profiler.deinit();
+
+  const double raysPerFrame = frames > 1 ? totalRays / (frames - 1) : 0;
+  const double gpuMs        = info.gpu.average / 1000.0;
+  const double mrays        = info.gpu.average > 0 ? raysPerFrame / info.gpu.average : 0;  // rays/us == Mrays/s
+  const bool   pass         = minMrays <= 0.f || mrays >= minMrays;
+
+  out << (firstRow ? "\n" : ",\n");
+  out << "        {\"renderer\": \"" << name << "\", \"first_frame_ms\": " << firstFrameMs
+      << ", \"render_gpu_ms\": " << gpuMs << ", \"mrays_per_s\": " << mrays << ", \"min_mrays_per_s\": " << minMrays
+      << ", \"pass\": " << (pass ? "true" : "false") << "}";
+  LOGI("Benchmark:   %-12s first frame %7.1f ms, render %6.2f ms, %8.2f Mrays/s %s\n", name, firstFrameMs, gpuMs,
+       mrays, pass ? "" : "[FAIL]");
+  return pass;
+}
+
+//--------------------------------------------------------------------------------------------------
+// One scene of the suite, on its own context and device like a headless run; returns whether
+// all gated renderers met their threshold
+//
+static bool benchScene(const BenchScene& bs, const std::string& hdrFilename, const VkExtent2D& size, int frames,
+                       std::ofstream& out, bool firstRow) {
+  // Same context as the headless path, minus the surface and swapchain extensions
+  nvvk::ContextCreateInfo contextInfo(true);
+  contextInfo.setVersion(1, 2);
+  contextInfo.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, true);
+
+  VkPhysicalDeviceShaderClockFeaturesKHR clockFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME, false, &clockFeature);
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, false, &accelFeature);
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, false, &rtPipelineFeature);
+  VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME, true, &rayQueryFeatures);
+  contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+  contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+  contextInfo.addRequestedQueue(contextInfo.defaultQueueGCT, 1, 1.0f);
+
+  nvvk::Context vkctx{};
+  vkctx.initInstance(contextInfo);
+  auto compatibleDevices = vkctx.getCompatibleDevices(contextInfo);
+  assert(!compatibleDevices.empty());
+  vkctx.initDevice(compatibleDevices[0], contextInfo);
+
+  Simulator sim;
+  sim.supportRayQuery(vkctx.hasDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME));
+
+  auto                     qGCT1 = vkctx.createQueue(contextInfo.defaultQueueGCT, "GCT1", 1.0f);
+  std::vector<nvvk::Queue> queues;
+  queues.push_back({vkctx.m_queueGCT.queue, vkctx.m_queueGCT.familyIndex, vkctx.m_queueGCT.queueIndex});
+  queues.push_back({qGCT1.queue, qGCT1.familyIndex, qGCT1.queueIndex});
+  queues.push_back({vkctx.m_queueC.queue, vkctx.m_queueC.familyIndex, vkctx.m_queueC.queueIndex});
+  queues.push_back({vkctx.m_queueT.queue, vkctx.m_queueT.familyIndex, vkctx.m_queueT.queueIndex});
+  sim.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, queues);
+
+  LOGI("Benchmark: %s\n", bs.file.c_str());
+  sim.loadEnvironmentHdr(hdrFilename);
+
+  // Scene load and AS build, the stages otherwise folded into loadScene
+  MilliTimer loadTimer;
+  sim.m_scene.load(bs.file);
+  const double sceneLoadMs = loadTimer.elapsed();
+  MilliTimer asTimer;
+  sim.m_accelStruct.create(sim.m_scene.getScene(), sim.m_scene.getInstData());
+  const double asBuildMs = asTimer.elapsed();
+  sim.m_picker.setTlas(sim.m_accelStruct.getTlas());
+
+  // Fixed, minimal settings: everything measured is the path trace itself
+  sim.m_settings.rayStatistics = true;
+  sim.m_settings.reproject     = false;
+  sim.m_rtxState.accumulate    = 1;
+  sim.m_maxFrames              = frames;
+  sim.prepareHeadless(size, Simulator::eRtxPipeline);
+
+  out << (firstRow ? "\n" : ",\n");
+  out << "    {\"scene\": \"" << bs.file << "\", \"scene_load_ms\": " << sceneLoadMs
+      << ", \"as_build_ms\": " << asBuildMs << ",\n      \"renderers\": [";
+
+  bool pass = benchRenderer(sim, Simulator::eRtxPipeline, "RtxPipeline", bs.minMrays, frames, out, true);
+  if (sim.m_supportRayQuery)
+    pass &= benchRenderer(sim, Simulator::eRayQuery, "RayQuery", bs.minMrays, frames, out, false);
+  out << "\n      ]}";
+
+  vkDeviceWaitIdle(sim.getDevice());
+  sim.destroyResources();
+  sim.destroy();
+  vkctx.deinit();
+  return pass;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Runs the whole suite and streams the JSON report; returns the process exit code, non-zero
+// when any gated measure failed
+//
+int runBenchmark(const InputParser& parser, const std::string& hdrFilename) {
+  const std::string suiteFile = parser.getString("--benchmark", "");
+  VkExtent2D        size{static_cast<uint32_t>(parser.getInt("--width", 1920)),
+                         static_cast<uint32_t>(parser.getInt("--height", 1080))};
+  const int         frames  = parser.getInt("--frames", 200);
+  const std::string outFile = parser.getString("--bench-out", "benchmark.json");
+
+  std::vector<BenchScene> scenes = parseSuite(suiteFile);
+  if (scenes.empty()) {
+    LOGE("Benchmark: no scenes in %s\n", suiteFile.c_str());
+    return 1;
+  }
+
+  std::ofstream out(outFile);
+  out << "{\n  \"width\": " << size.width << ",\n  \"height\": " << size.height << ",\n  \"frames\": " << frames
+      << ",\n  \"scenes\": [";
+
+  const std::string hdr = nvh::findFile(hdrFilename, defaultSearchPaths, true);
+
+  bool pass     = true;
+  bool firstRow = true;
+  for (auto& bs : scenes) {
+    bs.file = nvh::findFile(bs.file, defaultSearchPaths, true);
+    pass &= benchScene(bs, hdr, size, frames, out, firstRow);
+    firstRow = false;
+  }
+
+  out << "\n  ],\n  \"pass\": " << (pass ? "true" : "false") << "\n}\n";
+  LOGI("Benchmark: %s, report in %s\n", pass ? "PASS" : "FAIL", outFile.c_str());
+  return pass ? 0 : 1;
+}
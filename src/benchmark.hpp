@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <string>
+
+#include "nvh/inputparser.h"
+
+/*
+
+ #Bench
+ Reproducible performance suite for regression tracking across drivers and scenes. Each scene
+ of the suite file is loaded like a headless run, the camera replays a fixed one-turn orbit of
+ the scene bounds, and both the RtxPipeline and RayQuery renderers trace a fixed number of
+ frames. The seeds are deterministic by construction: the shaders derive them from the pixel
+ and the frame number, and both are fixed here.
+
+ Per scene and renderer, the run reports the scene load and AS build times, the wall-clock
+ first-frame latency (includes pipeline creation) and the steady-state throughput in Mrays/s,
+ measured from the #Stats ray counters against the "Render" GPU timer. Results stream to a
+ JSON file; a scene can carry a minimum Mrays/s gate and the process exit code is non-zero
+ when any gated measure fails, so CI can consume the run directly.
+
+ * Usage
+  - --benchmark suite.txt, with --width/--height/--frames as in the headless mode and
+    --bench-out for the JSON (default benchmark.json)
+  - suite file: one scene per line, "<scene.gltf> [min Mrays/s]"; 0 or no gate reports only;
+    '#' starts a comment
+  - the `benchmark` CMake target runs the bundled suite
+
+*/
+int runBenchmark(const InputParser& parser, const std::string& hdrFilename);
@@ -78,7 +78,7 @@ void DenoiserOptix::setup(const VkDevice& device, const VkPhysicalDevice& physic
 //--------------------------------------------------------------------------------------------------
 // Initializing OptiX and creating the Denoiser instance
 //
-bool DenoiserOptix::initOptiX(const OptixDenoiserOptions& options, OptixPixelFormat pixelFormat, bool hdr)
+bool DenoiserOptix::initOptiX(const OptixDenoiserOptions& options, OptixPixelFormat pixelFormat, bool hdr, bool temporal)
 {
   CUresult cu_res = cuInit(0);  // Initialize CUDA driver API.
   if(cu_res != CUDA_SUCCESS)
@@ -144,8 +144,9 @@ bool DenoiserOptix::initOptiX(const OptixDenoiserOptions& options, OptixPixelFor
 
   // This is to use RGB + Albedo + Normal
   m_dOptions                        = options;
+  m_temporal                        = temporal;
   OptixDenoiserModelKind model_kind = hdr ? OPTIX_DENOISER_MODEL_KIND_HDR : OPTIX_DENOISER_MODEL_KIND_LDR;
-  model_kind                        = OPTIX_DENOISER_MODEL_KIND_AOV;
+  model_kind                        = temporal ? OPTIX_DENOISER_MODEL_KIND_TEMPORAL : OPTIX_DENOISER_MODEL_KIND_AOV;
   OPTIX_CHECK(optixDenoiserCreate(g_m_optix_device, model_kind, &m_dOptions, &m_denoiser));
 
 
@@ -183,6 +184,14 @@ void DenoiserOptix::denoiseImageBuffer(uint64_t& fenceValue)
     layer.output.pixelStrideInBytes = sizeof(float) * 4;
     layer.output.format             = pixel_format;
 
+    // Temporal model : last frame's denoised result, warped with the motion vectors.
+    // On the very first frame there is nothing to warp, the input acts as its own history.
+    if(m_temporal)
+    {
+      layer.previousOutput      = layer.output;
+      layer.previousOutput.data = m_firstFrame ? layer.input.data : (CUdeviceptr)m_pixelBufferPrev.cudaPtr;
+    }
+
 
     OptixDenoiserGuideLayer guide_layer = {};
     // albedo
@@ -207,6 +216,17 @@ void DenoiserOptix::denoiseImageBuffer(uint64_t& fenceValue)
       guide_layer.normal.format             = pixel_format;
     }
 
+    // flow (temporal model)
+    if(m_temporal)
+    {
+      guide_layer.flow.data               = (CUdeviceptr)m_pixelBufferFlow.cudaPtr;
+      guide_layer.flow.width              = m_imageSize.width;
+      guide_layer.flow.height             = m_imageSize.height;
+      guide_layer.flow.rowStrideInBytes   = 2 * sizeof(float) * m_imageSize.width;
+      guide_layer.flow.pixelStrideInBytes = 2 * sizeof(float);
+      guide_layer.flow.format             = OPTIX_PIXEL_FORMAT_FLOAT2;
+    }
+
     // Wait from Vulkan (Copy to Buffer)
     cudaExternalSemaphoreWaitParams wait_params{};
     wait_params.flags              = 0;
@@ -229,6 +249,14 @@ void DenoiserOptix::denoiseImageBuffer(uint64_t& fenceValue)
     OPTIX_CHECK(optixDenoiserInvoke(m_denoiser, m_cuStream, &denoiser_params, m_dStateBuffer, m_dSizes.stateSizeInBytes, &guide_layer,
                                     &layer, 1, 0, 0, m_dScratchBuffer, m_dSizes.withoutOverlapScratchSizeInBytes));
 
+    // Keep the denoised result as the history of the next frame
+    if(m_temporal)
+    {
+      size_t buf_size = static_cast<size_t>(m_imageSize.width) * m_imageSize.height * 4 * sizeof(float);
+      CUDA_CHECK(cudaMemcpyAsync(m_pixelBufferPrev.cudaPtr, m_pixelBufferOut.cudaPtr, buf_size,
+                                 cudaMemcpyDeviceToDevice, m_cuStream));
+      m_firstFrame = false;
+    }
 
     CUDA_CHECK(cudaStreamSynchronize(m_cuStream));  // Making sure the denoiser is done
 
@@ -352,9 +380,28 @@ void DenoiserOptix::destroy()
 //
 void DenoiserOptix::destroyBuffer()
 {
-  for(auto& p : m_pixelBufferIn)
-    p.destroy(m_allocEx);
-  m_pixelBufferOut.destroy(m_allocEx);
+  // In zero-copy mode the Vulkan buffers belong to the caller, only the export handles are ours
+  if(m_imported)
+  {
+    for(auto& p : m_pixelBufferIn)
+    {
+      p.closeHandle();
+      p.bufVk = {};
+    }
+    m_pixelBufferOut.closeHandle();
+    m_pixelBufferOut.bufVk = {};
+    m_pixelBufferFlow.closeHandle();
+    m_pixelBufferFlow.bufVk = {};
+    m_pixelBufferPrev.closeHandle();
+    m_pixelBufferPrev.bufVk = {};
+    m_imported              = false;
+  }
+  else
+  {
+    for(auto& p : m_pixelBufferIn)
+      p.destroy(m_allocEx);
+    m_pixelBufferOut.destroy(m_allocEx);
+  }
 
   if(m_dStateBuffer != 0)
   {
@@ -408,30 +455,77 @@ void DenoiserOptix::allocateBuffers(const VkExtent2D& imgSize)
 
   {  // Color
     m_pixelBufferIn[0].bufVk = m_allocEx.createBuffer(buffer_size, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-    createBufferCuda(m_pixelBufferIn[0]);  // Exporting the buffer to Cuda handle and pointers
+    createBufferCuda(m_pixelBufferIn[0], m_allocEx);  // Exporting the buffer to Cuda handle and pointers
     NAME_VK(m_pixelBufferIn[0].bufVk.buffer);
   }
 
   // Albedo
   {
     m_pixelBufferIn[1].bufVk = m_allocEx.createBuffer(buffer_size, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-    createBufferCuda(m_pixelBufferIn[1]);
+    createBufferCuda(m_pixelBufferIn[1], m_allocEx);
     NAME_VK(m_pixelBufferIn[1].bufVk.buffer);
   }
   // Normal
   {
     m_pixelBufferIn[2].bufVk = m_allocEx.createBuffer(buffer_size, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-    createBufferCuda(m_pixelBufferIn[2]);
+    createBufferCuda(m_pixelBufferIn[2], m_allocEx);
     NAME_VK(m_pixelBufferIn[2].bufVk.buffer);
   }
 
   // Output image/buffer
   m_pixelBufferOut.bufVk = m_allocEx.createBuffer(buffer_size, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
-  createBufferCuda(m_pixelBufferOut);
+  createBufferCuda(m_pixelBufferOut, m_allocEx);
   NAME_VK(m_pixelBufferOut.bufVk.buffer);
 
+  allocateDenoiserState();
+}
 
-  // Computing the amount of memory needed to do the denoiser
+//--------------------------------------------------------------------------------------------------
+// Zero-copy mode: the buffers were allocated by the caller (see RenderOutput) in exported memory
+// and are filled directly by the path tracers. Here we only map them into Cuda and size the
+// denoiser state; denoiseImageBuffer() then runs in place, without any image<->buffer copy.
+//
+void DenoiserOptix::importBuffers(nvvk::ResourceAllocator&           alloc,
+                                  const std::array<nvvk::Buffer, 3>& bufsIn,
+                                  const nvvk::Buffer&                bufOut,
+                                  const VkExtent2D&                  imgSize,
+                                  const nvvk::Buffer&                bufFlow,
+                                  const nvvk::Buffer&                bufPrev)
+{
+  m_imageSize = imgSize;
+
+  destroyBuffer();
+  m_imported   = true;
+  m_firstFrame = true;
+
+  for(size_t i = 0; i < bufsIn.size(); i++)
+  {
+    m_pixelBufferIn[i].bufVk = bufsIn[i];
+    createBufferCuda(m_pixelBufferIn[i], alloc);
+  }
+  m_pixelBufferOut.bufVk = bufOut;
+  createBufferCuda(m_pixelBufferOut, alloc);
+
+  // Motion vectors and history, only needed by the temporal model
+  if(bufFlow.buffer != VK_NULL_HANDLE)
+  {
+    m_pixelBufferFlow.bufVk = bufFlow;
+    createBufferCuda(m_pixelBufferFlow, alloc);
+  }
+  if(bufPrev.buffer != VK_NULL_HANDLE)
+  {
+    m_pixelBufferPrev.bufVk = bufPrev;
+    createBufferCuda(m_pixelBufferPrev, alloc);
+  }
+
+  allocateDenoiserState();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Computing the amount of memory needed by the denoiser and setting it up
+//
+void DenoiserOptix::allocateDenoiserState()
+{
   OPTIX_CHECK(optixDenoiserComputeMemoryResources(m_denoiser, m_imageSize.width, m_imageSize.height, &m_dSizes));
 
   CUDA_CHECK(cudaMalloc((void**)&m_dStateBuffer, m_dSizes.stateSizeInBytes));
@@ -448,9 +542,9 @@ void DenoiserOptix::allocateBuffers(const VkExtent2D& imgSize)
 //--------------------------------------------------------------------------------------------------
 // Get the Vulkan buffer and create the Cuda equivalent using the memory allocated in Vulkan
 //
-void DenoiserOptix::createBufferCuda(BufferCuda& buf)
+void DenoiserOptix::createBufferCuda(BufferCuda& buf, nvvk::ResourceAllocator& alloc)
 {
-  nvvk::MemAllocator::MemInfo mem_info = m_allocEx.getMemoryAllocator()->getMemoryInfo(buf.bufVk.memHandle);
+  nvvk::MemAllocator::MemInfo mem_info = alloc.getMemoryAllocator()->getMemoryInfo(buf.bufVk.memHandle);
 #ifdef WIN32
   VkMemoryGetWin32HandleInfoKHR info{VK_STRUCTURE_TYPE_MEMORY_GET_WIN32_HANDLE_INFO_KHR};
   info.memory     = mem_info.memory;
@@ -99,7 +99,7 @@ struct DenoiserOptix
   ~DenoiserOptix() { cuCtxDestroy(m_cudaContext); }
 
   void setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t queueIndex);
-  bool initOptiX(const OptixDenoiserOptions& options, OptixPixelFormat pixelFormat, bool hdr);
+  bool initOptiX(const OptixDenoiserOptions& options, OptixPixelFormat pixelFormat, bool hdr, bool temporal = false);
   void denoiseImageBuffer(uint64_t& fenceValue);
   void createSemaphore();
 
@@ -109,6 +109,12 @@ struct DenoiserOptix
   bool uiSetup();
 
   void allocateBuffers(const VkExtent2D& imgSize);
+  void importBuffers(nvvk::ResourceAllocator& alloc,
+                     const std::array<nvvk::Buffer, 3>& bufsIn,
+                     const nvvk::Buffer&                bufOut,
+                     const VkExtent2D&                  imgSize,
+                     const nvvk::Buffer&                bufFlow = {},
+                     const nvvk::Buffer&                bufPrev = {});
   void bufferToImage(const VkCommandBuffer& cmdBuf, nvvk::Texture* imgOut);
   void imageToBuffer(const VkCommandBuffer& cmdBuf, const std::vector<nvvk::Texture>& imgIn);
   void bufferToBuffer(const VkCommandBuffer& cmdBuf, const std::vector<nvvk::Buffer>& bufIn);
@@ -140,6 +146,12 @@ private:
     void destroy(nvvk::ExportResourceAllocator& alloc)
     {
       alloc.destroy(bufVk);
+      closeHandle();
+    }
+
+    // Only closes the export handle, for buffers owned by someone else (see importBuffers)
+    void closeHandle()
+    {
 #ifdef WIN32
       CloseHandle(handle);
       handle = nullptr;
@@ -153,7 +165,8 @@ private:
     }
   };
 
-  void createBufferCuda(BufferCuda& buf);
+  void createBufferCuda(BufferCuda& buf, nvvk::ResourceAllocator& alloc);
+  void allocateDenoiserState();
 
 
   // For synchronizing with Vulkan
@@ -186,8 +199,13 @@ private:
   nvvk::ExportResourceAllocator  m_allocEx;   // ResourceAllocator with export flag (interop)
 
   VkExtent2D                m_imageSize{};
-  std::array<BufferCuda, 3> m_pixelBufferIn;  // RGB, Albedo, normal
+  std::array<BufferCuda, 3> m_pixelBufferIn;    // RGB, Albedo, normal
   BufferCuda                m_pixelBufferOut;
+  BufferCuda                m_pixelBufferFlow;  // Motion vectors (temporal model)
+  BufferCuda                m_pixelBufferPrev;  // Previous denoised color (temporal model)
+  bool                      m_imported{false};  // Buffers owned by the caller (zero-copy mode)
+  bool                      m_temporal{false};  // Using the temporal model with flow input
+  bool                      m_firstFrame{true}; // No previous output to warp yet
 
   OptixPixelFormat       m_pixelFormat;
   uint32_t               m_sizeofPixel{};
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ *  #Stream : fence-paced readback ring and TCP stream of the rendered frames (see header)
+ */
+
+#include "frame_stream.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "nvh/nvprint.hpp"
+#include "nvvk/images_vk.hpp"
+#include "simulator.hpp"  // halfToFloat, for the #HalfPrec targets
+
+#ifdef _WIN32
+#include <winsock2.h>
+using socket_t = SOCKET;
+static void closeSocket(socket_t s) {
+  closesocket(s);
+}
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using socket_t = int;
+static void closeSocket(socket_t s) {
+  close(s);
+}
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // Not on Windows; a broken pipe is reported by send() there
+#endif
+
+// Same "sRGB-ish" transfer as the headless writeImage; the client displays the bytes as-is
+static uint8_t tonemap8(float v) {
+  return static_cast<uint8_t>(powf(std::min(std::max(v, 0.f), 1.f), 1.f / 2.2f) * 255.f);
+}
+
+// send() until done; false when the client went away
+static bool sendAll(socket_t s, const void* data, size_t size) {
+  const char* ptr = static_cast<const char*>(data);
+  while (size > 0) {
+    auto n = send(s, ptr, static_cast<int>(size), MSG_NOSIGNAL);
+    if (n <= 0)
+      return false;
+    ptr += n;
+    size -= n;
+  }
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creating the per-slot command buffers and fences; the buffers follow the frame size lazily
+//
+void FrameStream::setup(const VkDevice& device, uint32_t familyIndex, VkQueue queue, nvvk::ResourceAllocator* allocator) {
+  m_device = device;
+  m_queue  = queue;
+  m_pAlloc = allocator;
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = familyIndex;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_cmdPool);
+
+  VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.commandPool        = m_cmdPool;
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  for (auto& slot : m_slots) {
+    vkAllocateCommandBuffers(m_device, &allocInfo, &slot.cmdBuf);
+    vkCreateFence(m_device, &fenceInfo, nullptr, &slot.fence);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Opening the listen socket and starting the consumer thread; 0 leaves streaming disabled
+//
+void FrameStream::init(int port) {
+  if (port <= 0)
+    return;
+
+#ifdef _WIN32
+  WSADATA wsa;
+  WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+
+  socket_t s = socket(AF_INET, SOCK_STREAM, 0);
+  int      reuse{1};
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+  sockaddr_in addr{};
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port        = htons(static_cast<uint16_t>(port));
+  if (bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(s, 1) != 0) {
+    LOGW("Stream: could not listen on port %d\n", port);
+    closeSocket(s);
+    return;
+  }
+
+  m_listenSocket = static_cast<int64_t>(s);
+  m_active       = true;
+  m_stop         = false;
+  m_thread       = std::thread([this] { consumerLoop(); });
+  LOGI("Stream: listening on port %d\n", port);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Copies the frame into the next free slot and hands it to the consumer thread. Called right
+// after the frame submission: queue order puts the copy behind the rendering, and the barriers
+// inside the command buffer make the dependency. A full ring drops the frame, never stalls.
+//
+void FrameStream::record(const nvvk::Texture& frame, const VkRect2D& region, VkFormat format, int frameNumber) {
+  if (!m_active || !m_clientConnected)
+    return;
+
+  const uint32_t index = m_slotIndex;
+  Slot&          slot  = m_slots[index];
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (slot.busy) {
+      m_dropped++;
+      return;
+    }
+    slot.busy = true;
+  }
+  m_slotIndex = (index + 1) % s_ringSize;
+
+  const VkExtent2D&  size       = region.extent;
+  const bool         half       = format == VK_FORMAT_R16G16B16A16_SFLOAT;
+  const VkDeviceSize texelBytes = half ? 4 * sizeof(uint16_t) : 4 * sizeof(float);
+  const VkDeviceSize bufSize    = static_cast<VkDeviceSize>(size.width) * size.height * texelBytes;
+  if (slot.capacity < bufSize) {
+    if (slot.mapped != nullptr)
+      m_pAlloc->unmap(slot.buffer);
+    m_pAlloc->destroy(slot.buffer);
+    slot.buffer =
+      m_pAlloc->createBuffer(bufSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    slot.mapped   = m_pAlloc->map(slot.buffer);
+    slot.capacity = bufSize;
+  }
+  slot.size   = size;
+  slot.format = format;
+  slot.frame  = frameNumber;
+
+  vkResetFences(m_device, 1, &slot.fence);
+
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(slot.cmdBuf, &beginInfo);
+
+  nvvk::cmdBarrierImageLayout(slot.cmdBuf, frame.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+  VkBufferImageCopy copyRegion{};
+  copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  copyRegion.imageSubresource.layerCount = 1;
+  copyRegion.imageOffset                 = {region.offset.x, region.offset.y, 0};
+  copyRegion.imageExtent                 = {size.width, size.height, 1};
+  vkCmdCopyImageToBuffer(slot.cmdBuf, frame.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer.buffer, 1, &copyRegion);
+
+  nvvk::cmdBarrierImageLayout(slot.cmdBuf, frame.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+  vkEndCommandBuffer(slot.cmdBuf);
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers    = &slot.cmdBuf;
+  vkQueueSubmit(m_queue, 1, &submitInfo, slot.fence);
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending.push_back(index);
+  }
+  m_cv.notify_one();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Consumer thread: waits for a slot fence, converts and sends, then frees the slot. Wakes up
+// periodically to poll the listen socket while no frames are in flight.
+//
+void FrameStream::consumerLoop() {
+  while (true) {
+    uint32_t index;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait_for(lock, std::chrono::milliseconds(100), [this] { return m_stop || !m_pending.empty(); });
+      if (m_stop && m_pending.empty())
+        return;
+      if (m_pending.empty()) {
+        lock.unlock();
+        pollAccept();
+        continue;
+      }
+      index = m_pending.front();
+      m_pending.pop_front();
+    }
+
+    Slot& slot = m_slots[index];
+    vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+    sendSlot(slot);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      slot.busy = false;
+    }
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// Accepts a pending client, one at a time; record() only submits copies while one is connected
+//
+void FrameStream::pollAccept() {
+  if (m_clientConnected)
+    return;
+
+  socket_t listenSocket = static_cast<socket_t>(m_listenSocket);
+  fd_set   readSet;
+  FD_ZERO(&readSet);
+  FD_SET(listenSocket, &readSet);
+  timeval tv{0, 0};
+  if (select(static_cast<int>(listenSocket) + 1, &readSet, nullptr, nullptr, &tv) <= 0)
+    return;
+
+  socket_t client = accept(listenSocket, nullptr, nullptr);
+  if (client == static_cast<socket_t>(-1))
+    return;
+
+  int nodelay{1};  // Frames are sent whole, do not let Nagle delay them
+  setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&nodelay), sizeof(nodelay));
+  m_clientSocket    = static_cast<int64_t>(client);
+  m_clientConnected = true;
+  LOGI("Stream: client connected\n");
+}
+
+//--------------------------------------------------------------------------------------------------
+// Tonemaps the slot to RGB8 and sends it; NVENC would take the slot here instead (see header)
+//
+void FrameStream::sendSlot(Slot& slot) {
+  if (!m_clientConnected)
+    return;
+
+  const size_t nbPixels = static_cast<size_t>(slot.size.width) * slot.size.height;
+  m_rgb.resize(nbPixels * 3);
+  if (slot.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+    const uint16_t* src = static_cast<const uint16_t*>(slot.mapped);
+    for (size_t i = 0; i < nbPixels; i++)
+      for (size_t c = 0; c < 3; c++)
+        m_rgb[i * 3 + c] = tonemap8(Simulator::halfToFloat(src[i * 4 + c]));
+  } else {
+    const float* src = static_cast<const float*>(slot.mapped);
+    for (size_t i = 0; i < nbPixels; i++)
+      for (size_t c = 0; c < 3; c++)
+        m_rgb[i * 3 + c] = tonemap8(src[i * 4 + c]);
+  }
+
+  socket_t       client    = static_cast<socket_t>(m_clientSocket);
+  const uint32_t header[4] = {0x53465450u /*'PTFS'*/, slot.size.width, slot.size.height,
+                              static_cast<uint32_t>(slot.frame)};
+  if (!sendAll(client, header, sizeof(header)) || !sendAll(client, m_rgb.data(), m_rgb.size())) {
+    closeSocket(client);
+    m_clientConnected = false;
+    LOGI("Stream: client disconnected\n");
+    return;
+  }
+  m_sent++;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Joining the consumer thread and releasing the ring; the device is idle by now
+//
+void FrameStream::deinit() {
+  if (m_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+  }
+
+  if (m_clientConnected)
+    closeSocket(static_cast<socket_t>(m_clientSocket));
+  if (m_listenSocket != -1)
+    closeSocket(static_cast<socket_t>(m_listenSocket));
+  m_clientConnected = false;
+  m_listenSocket    = -1;
+#ifdef _WIN32
+  if (m_active)
+    WSACleanup();
+#endif
+
+  for (auto& slot : m_slots) {
+    if (slot.mapped != nullptr)
+      m_pAlloc->unmap(slot.buffer);
+    m_pAlloc->destroy(slot.buffer);
+    slot.mapped   = nullptr;
+    slot.capacity = 0;
+    if (slot.fence != VK_NULL_HANDLE)
+      vkDestroyFence(m_device, slot.fence, nullptr);
+    slot.fence = VK_NULL_HANDLE;
+  }
+  if (m_cmdPool != VK_NULL_HANDLE)
+    vkDestroyCommandPool(m_device, m_cmdPool, nullptr);
+  m_cmdPool = VK_NULL_HANDLE;
+
+  if (m_active)
+    LOGI("Stream: %d frames sent, %d dropped\n", m_sent, m_dropped);
+  m_active = false;
+}
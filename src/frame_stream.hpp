@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nvvk/resourceallocator_vk.hpp"
+
+/*
+
+ #Stream
+ Asynchronous readback of the rendered frame and a TCP stream of it, for viewing a headful run
+ from another machine. A small ring of host-visible buffers is paced by per-slot fences: right
+ after the frame is submitted, the image is copied into a free slot on the graphics queue; when
+ the ring is full the frame is dropped, submitFrame is never stalled. A consumer thread waits on
+ the slot fences, tonemaps the HDR pixels to RGB8 and sends them to the connected client, one
+ frame per packet: {'PTFS', width, height, frame} followed by width*height*3 bytes.
+
+ Hardware H.264 encode (NVENC) plugs in between the fence wait and the send: the slots are plain
+ buffers the Video Codec SDK can register, and the exported-memory allocator used for the
+ denoiser (RenderOutput::getExportAllocator) covers the zero-copy device path. The SDK is not
+ part of the build, so the shipping path streams raw tonemapped frames.
+
+ * Usage
+  - setup with the device and the graphics queue, then init with the port (--stream-port);
+    0 disables streaming
+  - record once per frame, right after submitFrame(); a no-op while no client is connected
+  - deinit joins the consumer thread and releases the ring
+
+*/
+class FrameStream {
+public:
+  void setup(const VkDevice& device, uint32_t familyIndex, VkQueue queue, nvvk::ResourceAllocator* allocator);
+  void init(int port);
+  void record(const nvvk::Texture& frame, const VkRect2D& region, VkFormat format, int frameNumber);
+  void deinit();
+
+  bool active() const {
+    return m_active;
+  }
+
+private:
+  // One in-flight readback; the fence paces the GPU copy, busy covers the whole slot lifetime
+  // until the consumer thread has sent the pixels
+  struct Slot {
+    nvvk::Buffer    buffer;
+    void*           mapped{nullptr};  // Persistently mapped, the consumer thread only reads
+    VkDeviceSize    capacity{0};
+    VkCommandBuffer cmdBuf{VK_NULL_HANDLE};
+    VkFence         fence{VK_NULL_HANDLE};
+    VkExtent2D      size{};
+    VkFormat        format{VK_FORMAT_UNDEFINED};
+    int             frame{0};
+    bool            busy{false};
+  };
+
+  void consumerLoop();
+  void pollAccept();
+  void sendSlot(Slot& slot);
+
+  static constexpr uint32_t s_ringSize{3};  // In-flight readbacks, matches the swapchain depth
+
+  std::array<Slot, s_ringSize> m_slots;
+  uint32_t                     m_slotIndex{0};
+
+  std::thread             m_thread;
+  std::mutex              m_mutex;
+  std::condition_variable m_cv;
+  std::deque<uint32_t>    m_pending;  // Slots with a submitted copy, in submission order
+  bool                    m_stop{false};
+
+  std::vector<uint8_t> m_rgb;  // Consumer-side RGB8 conversion buffer, reused between frames
+
+  int64_t           m_listenSocket{-1};  // Stored widened so the socket headers stay in the .cpp
+  int64_t           m_clientSocket{-1};
+  std::atomic<bool> m_clientConnected{false};
+
+  uint32_t m_sent{0};
+  uint32_t m_dropped{0};
+  bool     m_active{false};
+
+  // Setup
+  nvvk::ResourceAllocator* m_pAlloc{nullptr};
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  VkQueue                  m_queue{VK_NULL_HANDLE};
+  VkCommandPool            m_cmdPool{VK_NULL_HANDLE};
+};
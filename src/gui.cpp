@@ -31,7 +31,9 @@
 #include "imgui_helper.h"
 #include "imgui_internal.h"
 #include "imgui_orient.h"
+#include "rayquery.hpp"
 #include "rtx_pipeline.hpp"
+#include "wavefront.hpp"
 #include "simulator.hpp"
 //
 #include "gui.hpp"
@@ -188,6 +190,9 @@ void SimGUI::render(nvvk::ProfilerVK& profiler) {
     Gui::Group<bool>("Plot", false, [&] {
       return guiGpuMeasures();
     });
+    Gui::Group<bool>("Rays", false, [&] {
+      return guiRayStats();
+    });
   }
   ImGui::TextWrapped("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
                      ImGui::GetIO().Framerate);
@@ -271,8 +276,72 @@ bool SimGUI::guiRayTracing() {
                           "Speeding up rendering while camera moves.\n"
                           "Value of 1, will not de-scale",
                           &sim_->m_descalingLevel, nullptr, Normal, 1, 8);
+  // #DynRes : replaces the fixed de-scaling level with a closed-loop scale against the budget
+  changed |= GuiH::Checkbox("Dynamic Resolution",
+                            "Adjust the render resolution continuously while navigating\n"
+                            "to hold the target frame time, instead of the fixed level",
+                            &sim_->m_settings.dynamicResolution, nullptr);
+  if (sim_->m_settings.dynamicResolution) {
+    GuiH::Drag("Target Frame Time", "Render budget per frame, in milliseconds",
+               &sim_->m_settings.targetFrameTimeMs, nullptr, Normal, 1.f, 200.f, 0.5f);
+    char scaleTxt[32];
+    sprintf(scaleTxt, "%.0f%%", 100.f * sim_->m_renderScale);
+    GuiH::Info("Render Scale", "Current scale of the dynamic resolution", scaleTxt, GuiH::Flags::Disabled);
+  }
+  // #MultiView : the frame becomes an atlas of sensor-rig views, all traced by one dispatch
+  // against the same TLAS and scene buffers
+  changed |= GuiH::Slider("Views",
+                          "Sensor-rig cameras rendered as an atlas in a single dispatch,\n"
+                          "sharing the acceleration structure and pipelines",
+                          &sim_->m_settings.nbViews, nullptr, Normal, 1, MULTIVIEW_MAX_VIEWS);
+  // #Refit : moving geometry; wait idle so no in-flight frame (async compute) still reads the
+  // TLAS when the first refit rewrites it
+  if (GuiH::Checkbox("Animate",
+                     "Turntable the scene around its center,\n"
+                     "refitting the TLAS every frame",
+                     &sim_->m_settings.animate, nullptr)) {
+    vkDeviceWaitIdle(sim_->m_device);
+    changed = true;
+  }
   changed |= GuiH::Slider("Accumulate", "Enable accumulation over multiple frames", &rtxState.accumulate, nullptr);
+  changed |= GuiH::Checkbox("Reprojection",
+                            "Warm-start the accumulation after camera moves by\n"
+                            "reprojecting the previous frame where it is still valid",
+                            &sim_->m_settings.reproject, nullptr);
+
+  GuiH::Group<bool>("Adaptive Sampling", false, [&] {
+    auto& settings = sim_->m_settings;
+    changed |= GuiH::Checkbox("Enable Adaptive",
+                              "Stop tracing pixels whose luminance variance\n"
+                              "dropped below the threshold",
+                              &settings.adaptiveSampling, nullptr);
+    if (settings.adaptiveSampling) {
+      changed |= GuiH::Drag("Variance Threshold", "Relative standard error below which a pixel is converged",
+                            &settings.adaptiveThreshold, nullptr, Normal, 0.001f, 0.5f, 0.001f);
+      float total = float(rtxState.size.x) * float(rtxState.size.y);
+      char  conv[32];
+      sprintf(conv, "%.1f%%", total > 0 ? 100.f * sim_->m_convergedPixels / total : 0.f);
+      GuiH::Info("Converged", "Estimated portion of converged pixels", conv, GuiH::Flags::Disabled);
+    }
+    return changed;
+  });
+
+  GuiH::Group<bool>("Tiling", false, [&] {
+    auto& tiles = sim_->m_tiles;
+    changed |= GuiH::Checkbox("Enable Tiling",
+                              "Render the image in checkerboarded tiles, submitting only\n"
+                              "as many tiles per frame as fit in the target frame time",
+                              &tiles.enable, nullptr);
+    if (tiles.enable) {
+      changed |= GuiH::Slider("Tile Size", "Tile edge in pixels", &tiles.tileSize, nullptr, Normal, 64, 512);
+      GuiH::Drag("Target Frame Time", "Render budget per frame, in milliseconds", &tiles.targetFrameTimeMs, nullptr,
+                 Normal, 1.f, 200.f, 0.5f);
+      GuiH::Info("Tiles / Frame", "", FormatNumbers(tiles.tilesPerFrame), GuiH::Flags::Disabled);
+    }
+    return changed;
+  });
 
+  // #Variants : the BRDF model is folded into the pipelines, see updateShaderVariants below
   changed |= GuiH::Selection("Pbr Mode", "PBR material model", &rtxState.pbrMode, nullptr, Normal, {"Disney", "Gltf"});
 
   static bool bAnyHit = true;
@@ -288,6 +357,54 @@ bool SimGUI::guiRayTracing() {
     }
   }
 
+  // #Stats : the counters cost atomics in the hot loop, the pipelines are specialized without
+  // them when off
+  if (GuiH::Checkbox("Ray Statistics",
+                     "Count rays traced per frame with atomics.\n"
+                     "See the Rays group under Stats",
+                     &sim_->m_settings.rayStatistics, nullptr)) {
+    vkDeviceWaitIdle(sim_->m_device);  // cannot run while changing this
+    if (auto rtx = dynamic_cast<RtxPipeline*>(sim_->m_pRender[Simulator::eRtxPipeline]))
+      rtx->useRayStatistics(sim_->m_settings.rayStatistics);
+    if (auto rq = dynamic_cast<RayQuery*>(sim_->m_pRender[Simulator::eRayQuery]))
+      rq->useRayStatistics(sim_->m_settings.rayStatistics);
+    if (auto wf = dynamic_cast<Wavefront*>(sim_->m_pRender[Simulator::eWavefront]))
+      wf->useRayStatistics(sim_->m_settings.rayStatistics);
+    changed = true;
+  }
+
+  // #AsyncCompute : only the compute renderers can move to the compute queue
+  if (sim_->m_supportRayQuery) {
+    bool asyncCompute = sim_->m_settings.asyncCompute;
+    if (GuiH::Checkbox("Async Compute",
+                       "Run the compute path tracers on the compute queue,\n"
+                       "overlapped with post-processing, GUI and present",
+                       &asyncCompute, nullptr)) {
+      vkDeviceWaitIdle(sim_->m_device);  // cannot run while changing this
+      sim_->m_settings.asyncCompute = asyncCompute;
+      sim_->m_offscreen.setAsyncDisplay(asyncCompute);
+      changed = true;
+    }
+  }
+
+  // #HalfPrec : recreates the render targets in the requested precision and specializes the
+  // pipelines with the matching accumulation
+  if (GuiH::Checkbox("Half Precision Targets",
+                     "Accumulate in RGBA16F with an error-compensated mean,\n"
+                     "halving render-target bandwidth and VRAM",
+                     &sim_->m_settings.halfPrecision, nullptr)) {
+    vkDeviceWaitIdle(sim_->m_device);  // cannot run while changing this
+    sim_->m_offscreen.setHalfPrecision(sim_->m_settings.halfPrecision);
+    sim_->m_offscreen.update(sim_->m_size);
+    if (auto rtx = dynamic_cast<RtxPipeline*>(sim_->m_pRender[Simulator::eRtxPipeline]))
+      rtx->useHalfPrecision(sim_->m_settings.halfPrecision);
+    if (auto rq = dynamic_cast<RayQuery*>(sim_->m_pRender[Simulator::eRayQuery]))
+      rq->useHalfPrecision(sim_->m_settings.halfPrecision);
+    if (auto wf = dynamic_cast<Wavefront*>(sim_->m_pRender[Simulator::eWavefront]))
+      wf->useHalfPrecision(sim_->m_settings.halfPrecision);
+    changed = true;
+  }
+
   GuiH::Group<bool>("Debugging", false, [&] {
     changed |=
       GuiH::Selection("Debug Mode", "Display unique values of material", &rtxState.debugging_mode, nullptr, Normal,
@@ -317,10 +434,28 @@ bool SimGUI::guiRayTracing() {
     return changed;
   });
 
+  // #Variants : the pipelines are specialized without the debug/heatmap instrumentation and
+  // with a fixed BRDF model. Swap to the matching variant when either selection above moved;
+  // useShaderVariant is a no-op on renderers already holding it.
+  static bool lastDebugFeatures{false};
+  static int  lastPbrMode{0};
+  bool        debugFeatures = rtxState.debugging_mode != eNoDebug;
+  if (debugFeatures != lastDebugFeatures || rtxState.pbrMode != lastPbrMode) {
+    vkDeviceWaitIdle(sim_->m_device);  // cannot run while changing this
+    if (auto rtx = dynamic_cast<RtxPipeline*>(sim_->m_pRender[Simulator::eRtxPipeline]))
+      rtx->useShaderVariant(debugFeatures, rtxState.pbrMode);
+    if (auto rq = dynamic_cast<RayQuery*>(sim_->m_pRender[Simulator::eRayQuery]))
+      rq->useShaderVariant(debugFeatures, rtxState.pbrMode);
+    if (auto wf = dynamic_cast<Wavefront*>(sim_->m_pRender[Simulator::eWavefront]))
+      wf->useShaderVariant(debugFeatures, rtxState.pbrMode);
+    lastDebugFeatures = debugFeatures;
+    lastPbrMode       = rtxState.pbrMode;
+  }
+
   if (sim_->m_supportRayQuery) {
     Simulator::RndMethod method = sim_->m_rndMethod;  // renderMethod;
     if (GuiH::Selection<int>("Rendering Pipeline", "Choose the type of rendering", (int*)&method, nullptr,
-                             GuiH::Control::Flags::Normal, {"Rtx", "Compute"})) {
+                             GuiH::Control::Flags::Normal, {"Rtx", "Compute", "Wavefront"})) {
       sim_->createRender(method);
       //      sim_->renderMethod = method;
       changed = true;
@@ -493,6 +628,19 @@ bool SimGUI::guiStatistics() {
     GuiH::Info("Unique Tri", "", FormatNumbers(stats.nbUniqueTriangles));
   GuiH::Info("Resolution", "", std::to_string(sim_->m_size.width) + "x" + std::to_string(sim_->m_size.height));
 
+  // Acceleration structure memory, before and after the BLAS compaction pass
+  auto& asStats = sim_->m_accelStruct.getMemoryStats();
+  if (!asStats.blasCompactSize.empty()) {
+    auto inMiB = [](VkDeviceSize size) {
+      char s[32];
+      sprintf(s, "%.1f MiB", size / (1024.0 * 1024.0));
+      return std::string(s);
+    };
+    GuiH::Info("BLAS", "", FormatNumbers(asStats.blasCompactSize.size()));
+    GuiH::Info("AS Memory", "Bottom-level AS memory, built -> compacted",
+               inMiB(asStats.totalOriginalSize) + " -> " + inMiB(asStats.totalCompactSize));
+  }
+
   style.ItemSpacing = pushItem;
 
   return false;
@@ -634,6 +782,39 @@ bool SimGUI::guiGpuMeasures() {
   return false;
 }
 
+//--------------------------------------------------------------------------------------------------
+// #Stats : ray counters of a previous frame, collected with atomics in the path tracers
+//
+bool SimGUI::guiRayStats() {
+  if (!sim_->m_settings.rayStatistics) {
+    ImGui::TextWrapped("Enable Ray Statistics under Ray Tracing to collect the counters");
+    return false;
+  }
+
+  const auto& s = sim_->m_rayStats;
+  GuiH::Info("Primary Rays", "Camera rays traced last frame", FormatNumbers(s.primaryRays), GuiH::Flags::Disabled);
+  GuiH::Info("Bounce Rays", "Continuation segments after the first hit", FormatNumbers(s.bounceRays),
+             GuiH::Flags::Disabled);
+  GuiH::Info("Shadow Rays", "Light visibility tests", FormatNumbers(s.shadowRays), GuiH::Flags::Disabled);
+  GuiH::Info("AnyHit Calls", "Alpha-test invocations during traversal", FormatNumbers(s.anyHits),
+             GuiH::Flags::Disabled);
+
+  char text[32];
+  float avgDepth = s.primaryRays > 0 ? float(s.primaryRays + s.bounceRays) / float(s.primaryRays) : 0.f;
+  sprintf(text, "%.2f", avgDepth);
+  GuiH::Info("Avg Path Depth", "Average path segments per launched path", text, GuiH::Flags::Disabled);
+
+  // How much of the launched wavefront is still tracing at the average depth; paths that
+  // terminated early (env miss, Russian roulette, convergence) idle their lanes
+  float total = float(sim_->m_rtxState.size.x) * float(sim_->m_rtxState.size.y) * sim_->m_rtxState.maxSamples;
+  float occupancy =
+    total > 0 ? 100.f * float(s.primaryRays + s.bounceRays) / (total * sim_->m_rtxState.maxDepth) : 0.f;
+  sprintf(text, "%.1f%%", occupancy);
+  GuiH::Info("Occupancy", "Traced path segments over the full-depth wavefront", text, GuiH::Flags::Disabled);
+
+  return false;
+}
+
 //--------------------------------------------------------------------------------------------------
 // This is displaying information in the titlebar
 //
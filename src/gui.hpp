@@ -41,6 +41,7 @@ private:
   bool guiStatistics();
   bool guiProfiler(nvvk::ProfilerVK& profiler);
   bool guiGpuMeasures();
+  bool guiRayStats();  // #Stats
 
   Simulator* sim_{nullptr};
 };
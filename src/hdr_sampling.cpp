@@ -20,30 +20,63 @@
 /*
  *  HDR sampling is loading an HDR image and creating an acceleration structure for
  *  sampling the environment.
+ *
+ *  #HdrBuild : the alias map is built by compute kernels (hdr_*.comp) writing m_accelImpSmpl
+ *  directly: a reduction for the radiance integral, a partition of the texels into below /
+ *  above average, prefix sums over their deficits and excesses, and a pairing pass matching
+ *  each below-average texel to the above-average texel whose cumulative excess covers its
+ *  cumulative deficit. The former CPU build walked all texels serially, which took seconds
+ *  on large captures and blocked the loader thread on every environment swap; the only
+ *  host-side steps left are the texture upload and updateHdrDescriptors.
  */
 
 #define _USE_MATH_DEFINES
 #include "hdr_sampling.hpp"
 
 #include <cmath>
-#include <numeric>
 
 #include "nvh/fileoperations.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/debug_util_vk.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
 #include "stb_image.h"
-
-void HdrSampling::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex,
+#include "tools.hpp"
+
+// Shaders
+#include "autogen/hdr_alias_init.comp.h"
+#include "autogen/hdr_alias_pair.comp.h"
+#include "autogen/hdr_alias_pdf.comp.h"
+#include "autogen/hdr_reduce.comp.h"
+#include "autogen/hdr_reduce_final.comp.h"
+#include "autogen/hdr_scan_add.comp.h"
+#include "autogen/hdr_scan_local.comp.h"
+#include "autogen/hdr_scan_offset.comp.h"
+
+void HdrSampling::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, const nvvk::Queue& queue,
                         nvvk::ResourceAllocator* allocator) {
-  m_device      = device;
-  m_alloc       = allocator;
-  m_familyIndex = familyIndex;
+  m_device = device;
+  m_alloc  = allocator;
+  m_queue  = queue;
   m_debug.setup(device);
 }
 
 void HdrSampling::destroy() {
   m_alloc->destroy(m_texHdr);
   m_alloc->destroy(m_accelImpSmpl);
+
+  // #HdrBuild
+  for (auto& p : m_buildPipelines) {
+    vkDestroyPipeline(m_device, p, nullptr);
+    p = VK_NULL_HANDLE;
+  }
+  vkDestroyPipelineLayout(m_device, m_buildPipelineLayout, nullptr);
+  vkDestroyDescriptorPool(m_device, m_buildPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_buildSetLayout, nullptr);
+  m_buildPipelineLayout = VK_NULL_HANDLE;
+  m_buildPool           = VK_NULL_HANDLE;
+  m_buildSetLayout      = VK_NULL_HANDLE;
+  m_buildSet            = VK_NULL_HANDLE;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -72,161 +105,165 @@ void HdrSampling::loadEnvironment(const std::string& hrdImage) {
   VkImageCreateInfo icInfo       = nvvk::makeImage2DCreateInfo(imgSize, format);
 
   {
-    // We are using a different family index (1 - transfer), to allow loading in a different
-    // queue/thread that the display (0)
-    VkQueue queue;
-    vkGetDeviceQueue(m_device, m_familyIndex, 0, &queue);
-
-    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_familyIndex, queue);
+    // The queue of the loader thread (compute capable), so a swap never stalls the display queue
+    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_queue.familyIndex, m_queue.queue);
     nvvk::Image              image  = m_alloc->createImage(cmdBuf, bufferSize, pixels, icInfo);
     VkImageViewCreateInfo    ivInfo = nvvk::makeImageViewCreateInfo(image.image, icInfo);
     m_texHdr                        = m_alloc->createTexture(image, ivInfo, samplerCreateInfo);
     NAME_VK(m_texHdr.image);
-
-    auto envAccel  = createEnvironmentAccel(pixels, imgSize);
-    m_accelImpSmpl = m_alloc->createBuffer(cmdBuf, envAccel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
-    NAME_VK(m_accelImpSmpl.buffer);
   }
-  m_alloc->finalizeAndReleaseStaging();
-
   stbi_image_free(pixels);
-}
 
-//--------------------------------------------------------------------------------------------------
-// Build alias map for the importance sampling: Each texel is associated to another texel, or alias,
-// so that their combined intensities are a close as possible to the average of the environment map.
-// This will later allow the sampling shader to uniformly select a texel in the environment, and
-// select either that texel or its alias depending on their relative intensities
-//
-float HdrSampling::buildAliasmap(const std::vector<float>& data, std::vector<EnvAccel>& accel) {
-  auto size = static_cast<uint32_t>(data.size());
-
-  // Compute the integral of the emitted radiance of the environment map
-  // Since each element in data is already weighted by its solid angle
-  // the integral is a simple sum
-  float sum = std::accumulate(data.begin(), data.end(), 0.f);
-
-  // For each texel, compute the ratio q between the emitted radiance of the texel and the average
-  // emitted radiance over the entire sphere
-  // We also initialize the aliases to identity, ie. each texel is its own alias
-  auto  fSize          = static_cast<float>(size);
-  float inverseAverage = fSize / sum;
-  for (uint32_t i = 0; i < size; ++i) {
-    accel[i].q     = data[i] * inverseAverage;
-    accel[i].alias = i;
-  }
+  // #HdrBuild : the acceleration structure is written by the builder kernels, nothing is uploaded
+  m_accelImpSmpl =
+    m_alloc->createBuffer(VkDeviceSize(width) * height * sizeof(EnvAccel), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_accelImpSmpl.buffer);
 
-  // Partition the texels according to their emitted radiance ratio wrt. average.
-  // Texels with a value q < 1 (ie. below average) are stored incrementally from the beginning of the
-  // array, while texels emitting higher-than-average radiance are stored from the end of the array
-  std::vector<uint32_t> partitionTable(size);
-  uint32_t              s     = 0u;
-  uint32_t              large = size;
-  for (uint32_t i = 0; i < size; ++i) {
-    if (accel[i].q < 1.f)
-      partitionTable[s++] = i;
-    else
-      partitionTable[--large] = i;
-  }
+  createBuildPipelines();
+  buildAccel(imgSize);
 
-  // Associate the lower-energy texels to higher-energy ones. Since the emission of a high-energy texel may
-  // be vastly superior to the average,
-  for (s = 0; s < large && large < size; ++s) {
-    // Index of the smaller energy texel
-    const uint32_t smallEnergyIndex = partitionTable[s];
-
-    // Index of the higher energy texel
-    const uint32_t highEnergyIndex = partitionTable[large];
-
-    // Associate the texel to its higher-energy alias
-    accel[smallEnergyIndex].alias = highEnergyIndex;
-
-    // Compute the difference between the lower-energy texel and the average
-    const float differenceWithAverage = 1.f - accel[smallEnergyIndex].q;
-
-    // The goal is to obtain texel couples whose combined intensity is close to the average.
-    // However, some texels may have low energies, while others may have very high intensity
-    // (for example a sunset: the sky is quite dark, but the sun is still visible). In this case
-    // it may not be possible to obtain a value close to average by combining only two texels.
-    // Instead, we potentially associate a single high-energy texel to many smaller-energy ones until
-    // the combined average is similar to the average of the environment map.
-    // We keep track of the combined average by subtracting the difference between the lower-energy texel and the
-    // average from the ratio stored in the high-energy texel.
-    accel[highEnergyIndex].q -= differenceWithAverage;
-
-    // If the combined ratio to average of the higher-energy texel reaches 1, a balance has been found
-    // between a set of low-energy texels and the higher-energy one. In this case, we will use the next
-    // higher-energy texel in the partition when processing the next texel.
-    if (accel[highEnergyIndex].q < 1.0f)
-      large++;
-  }
-  // Return the integral of the emitted radiance. This integral will be used to normalize the probability
-  // distribution function (PDF) of each pixel
-  return sum;
+  m_alloc->finalizeAndReleaseStaging();
 }
 
-// CIE luminance
-inline float luminance(const float* color) {
-  return color[0] * 0.2126f + color[1] * 0.7152f + color[2] * 0.0722f;
+//--------------------------------------------------------------------------------------------------
+// #HdrBuild : barrier between the builder dispatches; every pass reads what the previous
+// one wrote
+//
+static void hdrBuildBarrier(VkCommandBuffer cmdBuf) {
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                       &barrier, 0, nullptr, 0, nullptr);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Create acceleration data for importance sampling
-// See:  https://arxiv.org/pdf/1901.05423.pdf
-std::vector<EnvAccel> HdrSampling::createEnvironmentAccel(const float* pixels, VkExtent2D& size) {
-  const uint32_t rx = size.width;
-  const uint32_t ry = size.height;
-
-  // Create importance sampling data
-  std::vector<EnvAccel> envAccel(rx * ry);
-  std::vector<float>    importanceData(rx * ry);
-  float                 cosTheta0 = 1.0f;
-  const float           stepPhi   = float(2.0 * M_PI) / float(rx);
-  const float           stepTheta = float(M_PI) / float(ry);
-  double                total     = 0;
-
-  // For each texel of the environment map, we compute the related solid angle
-  // subtended by the texel, and store the weighted luminance in importance_data,
-  // representing the amount of energy emitted through each texel.
-  // Also compute the average CIE luminance to drive the tonemapping of the final image
-  for (uint32_t y = 0; y < ry; ++y) {
-    const float theta1    = float(y + 1) * stepTheta;
-    const float cosTheta1 = std::cos(theta1);
-    const float area      = (cosTheta0 - cosTheta1) * stepPhi;  // solid angle
-    cosTheta0             = cosTheta1;
-
-    for (uint32_t x = 0; x < rx; ++x) {
-      const uint32_t idx          = y * rx + x;
-      const uint32_t idx4         = idx * 4;
-      float          cieLuminance = luminance(&pixels[idx4]);
-      importanceData[idx]         = area * std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2]));
-      total += cieLuminance;
-    }
-  }
-
-  m_average = static_cast<float>(total) / static_cast<float>(rx * ry);
-
-  // Build the alias map, which aims at creating a set of texel couples
-  // so that all couples emit roughly the same amount of energy. To this aim,
-  // each smaller radiance texel will be assigned an "alias" with higher emitted radiance
-  // As a byproduct this function also returns the integral of the radiance emitted by the environment
-  m_integral = buildAliasmap(importanceData, envAccel);
-
-  // We deduce the PDF of each texel by normalizing its emitted radiance by the radiance integral
-  const float invEnvIntegral = 1.0f / m_integral;
-  for (uint32_t i = 0; i < rx * ry; ++i) {
-    const uint32_t idx4 = i * 4;
-    envAccel[i].pdf     = std::max(pixels[idx4], std::max(pixels[idx4 + 1], pixels[idx4 + 2])) * invEnvIntegral;
-  }
+// #HdrBuild : the descriptor set of the builder and its eight pipelines over one layout;
+// created once, kept until destroy()
+//
+void HdrSampling::createBuildPipelines() {
+  if (m_buildPipelines[eReduce] != VK_NULL_HANDLE)
+    return;
+
+  nvvk::DescriptorSetBindings bind;
+  bind.addBinding({HdrBuildBindings::eHdrSource, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrAccel, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrScratch, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrPartition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrPartials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+
+  m_buildSetLayout = bind.createLayout(m_device);
+  m_buildPool      = bind.createPool(m_device);
+  m_buildSet       = nvvk::allocateDescriptorSet(m_device, m_buildPool, m_buildSetLayout);
+
+  VkPushConstantRange pushConstant{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HdrBuildState)};
+
+  VkPipelineLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  layoutInfo.pushConstantRangeCount = 1;
+  layoutInfo.pPushConstantRanges    = &pushConstant;
+  layoutInfo.setLayoutCount         = 1;
+  layoutInfo.pSetLayouts            = &m_buildSetLayout;
+  vkCreatePipelineLayout(m_device, &layoutInfo, nullptr, &m_buildPipelineLayout);
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  computePipelineCreateInfo.layout      = m_buildPipelineLayout;
+  computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  computePipelineCreateInfo.stage.pName = "main";
+
+  auto makePipeline = [&](BuildPass pass, const uint32_t* spirv, size_t spirvSize, const char* name) {
+    computePipelineCreateInfo.stage.module = nvvk::createShaderModule(m_device, spirv, spirvSize);
+    vkCreateComputePipelines(m_device, {}, 1, &computePipelineCreateInfo, nullptr, &m_buildPipelines[pass]);
+    m_debug.setObjectName(m_buildPipelines[pass], name);
+    vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
+  };
+
+  makePipeline(eReduce, hdr_reduce_comp, sizeof(hdr_reduce_comp), "HdrReduce");
+  makePipeline(eReduceFinal, hdr_reduce_final_comp, sizeof(hdr_reduce_final_comp), "HdrReduceFinal");
+  makePipeline(eAliasInit, hdr_alias_init_comp, sizeof(hdr_alias_init_comp), "HdrAliasInit");
+  makePipeline(eScanLocal, hdr_scan_local_comp, sizeof(hdr_scan_local_comp), "HdrScanLocal");
+  makePipeline(eScanOffset, hdr_scan_offset_comp, sizeof(hdr_scan_offset_comp), "HdrScanOffset");
+  makePipeline(eScanAdd, hdr_scan_add_comp, sizeof(hdr_scan_add_comp), "HdrScanAdd");
+  makePipeline(eAliasPair, hdr_alias_pair_comp, sizeof(hdr_alias_pair_comp), "HdrAliasPair");
+  makePipeline(eAliasPdf, hdr_alias_pdf_comp, sizeof(hdr_alias_pdf_comp), "HdrAliasPdf");
+}
 
-  // At runtime a texel will be uniformly chosen. Whether that texel or its alias is
-  // selected depends on the relative emitted radiances of the two texels.
-  // We store the PDF of the alias together with the PDF of the first member, so that both PDFs are
-  // available in a single lookup
-  for (uint32_t i = 0; i < rx * ry; ++i) {
-    const uint32_t aliasIdx = envAccel[i].alias;
-    envAccel[i].aliasPdf    = envAccel[aliasIdx].pdf;
-  }
+//--------------------------------------------------------------------------------------------------
+// #HdrBuild : recording and submitting the build. The working memory only lives for the
+// build; the host reads back the 16-byte info buffer for the integral and the average.
+//
+void HdrSampling::buildAccel(const VkExtent2D& size) {
+  MilliTimer timer;
+  LOGI("Building HDR alias map (GPU)");
+
+  const uint32_t nbTexels = size.width * size.height;
+  const uint32_t nbGroups = (nbTexels + HDR_BUILD_GROUP_SIZE - 1) / HDR_BUILD_GROUP_SIZE;
+
+  nvvk::Buffer info = m_alloc->createBuffer(sizeof(HdrBuildInfo), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  nvvk::Buffer scratch   = m_alloc->createBuffer(nbTexels * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  nvvk::Buffer partition = m_alloc->createBuffer(nbTexels * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  nvvk::Buffer partials  = m_alloc->createBuffer(nbGroups * sizeof(vec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+  nvvk::DescriptorSetBindings bind;
+  bind.addBinding({HdrBuildBindings::eHdrSource, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrAccel, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrInfo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrScratch, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrPartition, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({HdrBuildBindings::eHdrPartials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+
+  VkDescriptorBufferInfo accelDesc{m_accelImpSmpl.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo infoDesc{info.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo scratchDesc{scratch.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo partitionDesc{partition.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo partialsDesc{partials.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrSource, &m_texHdr.descriptor));
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrAccel, &accelDesc));
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrInfo, &infoDesc));
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrScratch, &scratchDesc));
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrPartition, &partitionDesc));
+  writes.emplace_back(bind.makeWrite(m_buildSet, HdrBuildBindings::eHdrPartials, &partialsDesc));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+  HdrBuildState state{};
+  state.hdrSize = ivec2(size.width, size.height);
 
-  return envAccel;
+  {
+    nvvk::ScopeCommandBuffer cmdBuf(m_device, m_queue.familyIndex, m_queue.queue);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_buildPipelineLayout, 0, 1, &m_buildSet, 0, nullptr);
+
+    auto dispatchPass = [&](BuildPass pass, uint32_t groups, int segment) {
+      state.segment = segment;
+      vkCmdPushConstants(cmdBuf, m_buildPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HdrBuildState), &state);
+      vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_buildPipelines[pass]);
+      vkCmdDispatch(cmdBuf, groups, 1, 1);
+      hdrBuildBarrier(cmdBuf);
+    };
+
+    dispatchPass(eReduce, nbGroups, 0);
+    dispatchPass(eReduceFinal, 1, 0);
+    dispatchPass(eAliasInit, nbGroups, 0);
+    for (int segment = 0; segment < 2; segment++) {  // 0 - deficits, 1 - excesses
+      dispatchPass(eScanLocal, nbGroups, segment);
+      dispatchPass(eScanOffset, 1, segment);
+      dispatchPass(eScanAdd, nbGroups, segment);
+    }
+    dispatchPass(eAliasPair, nbGroups, 0);
+    dispatchPass(eAliasPdf, nbGroups, 0);
+  }  // Submits and waits
+
+  auto* result = reinterpret_cast<HdrBuildInfo*>(m_alloc->map(info));
+  m_integral   = result->integral;
+  m_average    = result->average;
+  m_alloc->unmap(info);
+
+  m_alloc->destroy(info);
+  m_alloc->destroy(scratch);
+  m_alloc->destroy(partition);
+  m_alloc->destroy(partials);
+  timer.print();
 }
@@ -26,16 +26,18 @@
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/images_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
+#include "queue.hpp"
 #include "shaders/host_device.h"
 
 //--------------------------------------------------------------------------------------------------
 // Load an environment image (HDR) and create an acceleration structure for
-// important light sampling.
+// important light sampling. The alias map is built on the GPU (#HdrBuild), so swapping the
+// environment costs little more than the texture upload.
 class HdrSampling {
 public:
   HdrSampling() = default;
 
-  void setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex,
+  void setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, const nvvk::Queue& queue,
              nvvk::ResourceAllocator* allocator);
   void loadEnvironment(const std::string& hrdImage);
 
@@ -53,13 +55,22 @@ public:
 
 private:
   VkDevice                 m_device{VK_NULL_HANDLE};
-  uint32_t                 m_familyIndex{0};
+  nvvk::Queue              m_queue;
   nvvk::ResourceAllocator* m_alloc{nullptr};
   nvvk::DebugUtil          m_debug;
 
   float m_integral{1.f};
   float m_average{1.f};
 
-  float                 buildAliasmap(const std::vector<float>& data, std::vector<EnvAccel>& accel);
-  std::vector<EnvAccel> createEnvironmentAccel(const float* pixels, VkExtent2D& size);
+  // #HdrBuild : the alias-map builder kernels, in dispatch order (see hdr_*.comp)
+  enum BuildPass { eReduce, eReduceFinal, eAliasInit, eScanLocal, eScanOffset, eScanAdd, eAliasPair, eAliasPdf, ePassCount };
+
+  void createBuildPipelines();
+  void buildAccel(const VkExtent2D& size);
+
+  std::array<VkPipeline, ePassCount> m_buildPipelines{};
+  VkPipelineLayout                   m_buildPipelineLayout{VK_NULL_HANDLE};
+  VkDescriptorPool                   m_buildPool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout              m_buildSetLayout{VK_NULL_HANDLE};
+  VkDescriptorSet                    m_buildSet{VK_NULL_HANDLE};
 };
@@ -17,6 +17,8 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <algorithm>
+#include <cstring>
 #include <thread>
 
 #include "backends/imgui_impl_glfw.h"
@@ -24,6 +26,8 @@
 #include "nvh/fileoperations.hpp"
 #include "nvh/inputparser.h"
 #include "nvvk/context_vk.hpp"
+#include "benchmark.hpp"
+#include "profiler_export.hpp"
 #include "simulator.hpp"
 
 // Default search path for shaders
@@ -40,6 +44,109 @@ static void onErrorCallback(int error, const char* description) {
 static int const SAMPLE_WIDTH  = 1280;
 static int const SAMPLE_HEIGHT = 720;
 
+//--------------------------------------------------------------------------------------------------
+// #Headless / #MultiGPU
+// One fully independent replica per GPU: instance, device, allocator, acceleration structure.
+// Renders the given horizontal slice of the frame and reads its pixels back to the host; an
+// empty slice renders and reads the whole frame.
+//
+static void renderHeadlessSlice(const std::string& sceneFile, const std::string& hdrFilename,
+                                const VkExtent2D& renderSize, int frames, uint32_t deviceIndex, const VkRect2D& slice,
+                                std::vector<float>& pixels) {
+  // Same context as the windowed path, minus the surface and swapchain extensions
+  nvvk::ContextCreateInfo contextInfo(true);
+  contextInfo.setVersion(1, 2);
+  contextInfo.addInstanceExtension(VK_EXT_DEBUG_UTILS_EXTENSION_NAME, true);
+
+  VkPhysicalDeviceShaderClockFeaturesKHR clockFeature{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_CLOCK_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_SHADER_CLOCK_EXTENSION_NAME, false, &clockFeature);
+  VkPhysicalDeviceAccelerationStructureFeaturesKHR accelFeature{
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, false, &accelFeature);
+  VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtPipelineFeature{
+    VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME, false, &rtPipelineFeature);
+  VkPhysicalDeviceRayQueryFeaturesKHR rayQueryFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR};
+  contextInfo.addDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME, true, &rayQueryFeatures);
+  contextInfo.addDeviceExtension(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
+  contextInfo.addDeviceExtension(VK_KHR_BUFFER_DEVICE_ADDRESS_EXTENSION_NAME);
+  contextInfo.addRequestedQueue(contextInfo.defaultQueueGCT, 1, 1.0f);
+
+  nvvk::Context vkctx{};
+  vkctx.initInstance(contextInfo);
+  auto compatibleDevices = vkctx.getCompatibleDevices(contextInfo);
+  assert(deviceIndex < compatibleDevices.size());
+  vkctx.initDevice(compatibleDevices[deviceIndex], contextInfo);
+
+  Simulator sim;
+  sim.supportRayQuery(vkctx.hasDeviceExtension(VK_KHR_RAY_QUERY_EXTENSION_NAME));
+
+  auto                     qGCT1 = vkctx.createQueue(contextInfo.defaultQueueGCT, "GCT1", 1.0f);
+  std::vector<nvvk::Queue> queues;
+  queues.push_back({vkctx.m_queueGCT.queue, vkctx.m_queueGCT.familyIndex, vkctx.m_queueGCT.queueIndex});
+  queues.push_back({qGCT1.queue, qGCT1.familyIndex, qGCT1.queueIndex});
+  queues.push_back({vkctx.m_queueC.queue, vkctx.m_queueC.familyIndex, vkctx.m_queueC.queueIndex});
+  queues.push_back({vkctx.m_queueT.queue, vkctx.m_queueT.familyIndex, vkctx.m_queueT.queueIndex});
+
+  sim.setup(vkctx.m_instance, vkctx.m_device, vkctx.m_physicalDevice, queues);
+  sim.setRenderSlice(slice);
+  sim.renderHeadless(sceneFile, hdrFilename, renderSize, frames, "");
+  sim.readImage(slice.extent.width != 0 ? slice : VkRect2D{{0, 0}, renderSize}, pixels);
+
+  vkDeviceWaitIdle(sim.getDevice());
+  sim.destroyResources();
+  sim.destroy();
+  vkctx.deinit();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless
+// Batch rendering without GLFW, window surface or swapchain; for unattended runs on display-less
+// GPUs. With --gpus N, every compatible device renders a horizontal slice of the frame in its own
+// thread and the slices are gathered on the host; accumulation-heavy renders scale near linearly.
+//
+static int runHeadless(const InputParser& parser, const std::string& sceneFile, const std::string& hdrFilename) {
+  VkExtent2D renderSize{static_cast<uint32_t>(parser.getInt("--width", 1920)),
+                        static_cast<uint32_t>(parser.getInt("--height", 1080))};
+  int         frames  = parser.getInt("--frames", 1000);
+  std::string outFile = parser.getString("-o", "result.hdr");
+  int         nbGpus  = std::max(1, parser.getInt("--gpus", 1));
+
+  const std::string scene = nvh::findFile(sceneFile, defaultSearchPaths, true);
+  const std::string hdr   = nvh::findFile(hdrFilename, defaultSearchPaths, true);
+
+  if (nbGpus == 1) {
+    std::vector<float> pixels;
+    renderHeadlessSlice(scene, hdr, renderSize, frames, 0, {{0, 0}, {0, 0}}, pixels);
+    Simulator::writeImage(outFile, renderSize, pixels.data());
+    return 0;
+  }
+
+  // #MultiGPU : one replica per device, each rendering a horizontal slice of the frame
+  nbGpus = std::min(nbGpus, static_cast<int>(renderSize.height));
+  LOGI("Headless: splitting the frame over %d GPUs\n", nbGpus);
+  std::vector<std::vector<float>> slicePixels(nbGpus);
+  std::vector<VkRect2D>           slices(nbGpus);
+  std::vector<std::thread>        workers;
+  const uint32_t sliceHeight = (renderSize.height + nbGpus - 1) / nbGpus;
+  for (int g = 0; g < nbGpus; g++) {
+    const uint32_t y = g * sliceHeight;
+    slices[g] = {{0, static_cast<int32_t>(y)}, {renderSize.width, std::min(sliceHeight, renderSize.height - y)}};
+    workers.emplace_back(
+      [&, g] { renderHeadlessSlice(scene, hdr, renderSize, frames, static_cast<uint32_t>(g), slices[g], slicePixels[g]); });
+  }
+  for (auto& w : workers)
+    w.join();
+
+  // Gather the slices into the final image; the slices are full rows, so this is one copy each
+  std::vector<float> pixels(static_cast<size_t>(renderSize.width) * renderSize.height * 4);
+  for (int g = 0; g < nbGpus; g++)
+    memcpy(pixels.data() + static_cast<size_t>(slices[g].offset.y) * renderSize.width * 4, slicePixels[g].data(),
+           slicePixels[g].size() * sizeof(float));
+  Simulator::writeImage(outFile, renderSize, pixels.data());
+  return 0;
+}
+
 //--------------------------------------------------------------------------------------------------
 // Application Entry
 //
@@ -48,6 +155,22 @@ int main(int argc, char** argv) {
   std::string sceneFile   = parser.getString("-f", "assets/maps/default/main.gltf");
   std::string hdrFilename = parser.getString("-e", "assets/hdr/std_env.hdr");
 
+  // Search path for shaders and other media
+  defaultSearchPaths = {
+    NVPSystem::exePath() + PROJECT_NAME,
+    NVPSystem::exePath() + R"(media)",
+    NVPSystem::exePath() + PROJECT_RELDIRECTORY,
+    NVPSystem::exePath() + PROJECT_DOWNLOAD_RELDIRECTORY,
+  };
+
+  // #Headless : -f scene.gltf -e env.hdr --width W --height H --frames N -o out.hdr
+  if (parser.exist("--headless"))
+    return runHeadless(parser, sceneFile, hdrFilename);
+
+  // #Bench : --benchmark suite.txt, reproducible performance suite with a JSON report
+  if (parser.exist("--benchmark"))
+    return runBenchmark(parser, hdrFilename);
+
   // Setup GLFW window
   glfwSetErrorCallback(onErrorCallback);
   if (glfwInit() == GLFW_FALSE) {
@@ -69,14 +192,6 @@ int main(int argc, char** argv) {
   // Setup logging file
   //  nvprintSetLogFileName(PROJECT_NAME "_log.txt")
 
-  // Search path for shaders and other media
-  defaultSearchPaths = {
-    NVPSystem::exePath() + PROJECT_NAME,
-    NVPSystem::exePath() + R"(media)",
-    NVPSystem::exePath() + PROJECT_RELDIRECTORY,
-    NVPSystem::exePath() + PROJECT_DOWNLOAD_RELDIRECTORY,
-  };
-
   // Vulkan required extensions
   assert(glfwVulkanSupported() == 1);
   uint32_t count{0};
@@ -185,6 +300,13 @@ int main(int argc, char** argv) {
   profiler.init(vkctx.m_device, vkctx.m_physicalDevice, vkctx.m_queueGCT.familyIndex);
   profiler.setLabelUsage(true);  // depends on VK_EXT_debug_utils
 
+  // #Profile : --profile-out run.json (or .csv) streams the per-frame timings to disk
+  ProfilerExport profilerExport;
+  profilerExport.init(parser.getString("--profile-out", ""));
+
+  // #Stream : --stream-port 9999 serves the rendered frames to a remote viewer
+  sim.initFrameStream(parser.getInt("--stream-port", 0));
+
   // Main loop
   while (glfwWindowShouldClose(window) == GLFW_FALSE) {
     glfwPollEvents();
@@ -241,10 +363,13 @@ int main(int argc, char** argv) {
     }
 
     profiler.endFrame();
+    if (profilerExport.active())
+      profilerExport.record(profiler, sim.m_rtxState);
 
     // Submit for display
     vkEndCommandBuffer(cmdBuf);
     sim.submitFrame();
+    sim.streamFrame();  // #Stream : async readback of the frame just submitted
 
     CameraManip.updateAnim();
   }
@@ -253,6 +378,7 @@ int main(int argc, char** argv) {
   vkDeviceWaitIdle(sim.getDevice());
   sim.destroyResources();
   sim.destroy();
+  profilerExport.deinit();
   profiler.deinit();
   vkctx.deinit();
 
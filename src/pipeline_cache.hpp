@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "nvh/nvprint.hpp"
+#include "vulkan/vulkan_core.h"
+
+// VkPipelineCache which is pre-loaded from disk at init and serialized back at deinit.
+// After the first run, driver-side shader compilation of all pipelines created against
+// the cache is mostly skipped, making renderer (re)creation near-instant.
+//
+// Usage:
+// - init with the device and the file to persist to
+// - pass .cache to vkCreate*Pipelines
+// - deinit at shutdown (writes the file)
+struct PipelineCacheFile {
+  void init(VkDevice device, const std::string& filename) {
+    m_device   = device;
+    m_filename = filename;
+
+    // The driver validates the header (UUID, vendor) and ignores stale data
+    std::vector<char> data;
+    std::ifstream     file(filename, std::ios::binary | std::ios::ate);
+    if (file.is_open()) {
+      data.resize(file.tellg());
+      file.seekg(0);
+      file.read(data.data(), data.size());
+      LOGI("Pipeline cache: loaded %zu bytes from %s\n", data.size(), filename.c_str());
+    }
+
+    VkPipelineCacheCreateInfo createInfo{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData    = data.data();
+    if (vkCreatePipelineCache(m_device, &createInfo, nullptr, &cache) != VK_SUCCESS) {
+      // Corrupted cache data; fall back to an empty cache
+      createInfo.initialDataSize = 0;
+      createInfo.pInitialData    = nullptr;
+      vkCreatePipelineCache(m_device, &createInfo, nullptr, &cache);
+    }
+  }
+
+  void deinit() {
+    if (cache == VK_NULL_HANDLE)
+      return;
+
+    size_t size{0};
+    vkGetPipelineCacheData(m_device, cache, &size, nullptr);
+    std::vector<char> data(size);
+    vkGetPipelineCacheData(m_device, cache, &size, data.data());
+
+    std::ofstream file(m_filename, std::ios::binary | std::ios::trunc);
+    if (file.is_open()) {
+      file.write(data.data(), data.size());
+      LOGI("Pipeline cache: saved %zu bytes to %s\n", data.size(), m_filename.c_str());
+    }
+
+    vkDestroyPipelineCache(m_device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+  }
+
+  VkPipelineCache cache{VK_NULL_HANDLE};
+
+private:
+  VkDevice    m_device{VK_NULL_HANDLE};
+  std::string m_filename;
+};
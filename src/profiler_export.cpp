@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ *  #Profile : streaming exporter of the profiler sections and NVML measures (see header)
+ */
+
+#include "profiler_export.hpp"
+
+#include "nvh/nvprint.hpp"
+#include "nvml_monitor.hpp"
+
+#if defined(NVP_SUPPORTS_NVML)
+extern NvmlMonitor g_nvml;  // GPU load and memory
+#endif
+
+// The profiled sections exported each frame; missing sections (e.g. Mipmap without
+// auto-exposure) are written as zero so the columns stay stable
+static const char* s_sections[] = {"Render", "Tonemap", "Mipmap"};
+
+//--------------------------------------------------------------------------------------------------
+// Opening the output file; the format follows the extension
+//
+void ProfilerExport::init(const std::string& filename) {
+  if (filename.empty())
+    return;
+
+  m_csv = filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+  m_file.open(filename);
+  if (!m_file.is_open()) {
+    LOGW("Profile: could not open %s for writing\n", filename.c_str());
+    return;
+  }
+
+  m_firstRow  = true;
+  m_row       = 0;
+  m_startTime = std::chrono::high_resolution_clock::now();
+  LOGI("Profile: streaming to %s\n", filename.c_str());
+}
+
+//--------------------------------------------------------------------------------------------------
+// The settings the run was made with, written once before the first row
+//
+void ProfilerExport::writeHeader(const RtxState& state) {
+  if (m_csv) {
+    // Settings as a comment, then the column names
+    m_file << "# size=" << state.size.x << "x" << state.size.y << " maxDepth=" << state.maxDepth
+           << " maxSamples=" << state.maxSamples << " pbrMode=" << state.pbrMode << " accumulate=" << state.accumulate
+           << " adaptiveSampling=" << state.adaptiveSampling << " adaptiveThreshold=" << state.adaptiveThreshold
+           << "\n";
+    m_file << "time_ms,frame";
+    for (auto name : s_sections)
+      m_file << "," << name << "_gpu_ms," << name << "_cpu_ms";
+    m_file << ",gpu_load,gpu_mem_kb,cpu_load\n";
+    return;
+  }
+
+  m_file << "{\n  \"settings\": {\n";
+  m_file << "    \"width\": " << state.size.x << ",\n";
+  m_file << "    \"height\": " << state.size.y << ",\n";
+  m_file << "    \"maxDepth\": " << state.maxDepth << ",\n";
+  m_file << "    \"maxSamples\": " << state.maxSamples << ",\n";
+  m_file << "    \"pbrMode\": " << state.pbrMode << ",\n";
+  m_file << "    \"accumulate\": " << state.accumulate << ",\n";
+  m_file << "    \"adaptiveSampling\": " << state.adaptiveSampling << ",\n";
+  m_file << "    \"adaptiveThreshold\": " << state.adaptiveThreshold << "\n";
+  m_file << "  },\n  \"frames\": [";
+}
+
+//--------------------------------------------------------------------------------------------------
+// One row per frame: elapsed time, accumulation frame, GPU/CPU milliseconds of each profiled
+// section and the latest NVML measures. Streamed, memory use does not grow with the run length.
+//
+void ProfilerExport::record(nvvk::ProfilerVK& profiler, const RtxState& state) {
+  if (!m_file.is_open())
+    return;
+
+  if (m_firstRow)
+    writeHeader(state);
+
+  float timeMs =
+    std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - m_startTime).count();
+
+  float gpuLoad{0.f};
+  float gpuMem{0.f};
+  float cpuLoad{0.f};
+#if defined(NVP_SUPPORTS_NVML)
+  if (g_nvml.isValid() && g_nvml.nbGpu() > 0) {
+    uint32_t offset = g_nvml.getOffset();
+    gpuLoad         = g_nvml.getMeasures(0).load[offset];
+    gpuMem          = g_nvml.getMeasures(0).memory[offset];
+    cpuLoad         = g_nvml.getSysInfo().cpu[offset];
+  }
+#endif
+
+  if (m_csv) {
+    m_file << timeMs << "," << state.frame;
+    for (auto name : s_sections) {
+      nvh::Profiler::TimerInfo info{};
+      profiler.getTimerInfo(name, info);
+      m_file << "," << info.gpu.average / 1000.0 << "," << info.cpu.average / 1000.0;
+    }
+    m_file << "," << gpuLoad << "," << gpuMem << "," << cpuLoad << "\n";
+  } else {
+    m_file << (m_firstRow ? "\n" : ",\n");
+    m_file << "    {\"time_ms\": " << timeMs << ", \"frame\": " << state.frame;
+    for (auto name : s_sections) {
+      nvh::Profiler::TimerInfo info{};
+      profiler.getTimerInfo(name, info);
+      m_file << ", \"" << name << "_gpu_ms\": " << info.gpu.average / 1000.0  //
+             << ", \"" << name << "_cpu_ms\": " << info.cpu.average / 1000.0;
+    }
+    m_file << ", \"gpu_load\": " << gpuLoad << ", \"gpu_mem_kb\": " << gpuMem << ", \"cpu_load\": " << cpuLoad << "}";
+  }
+
+  m_firstRow = false;
+  if (++m_row % 64 == 0)
+    m_file.flush();  // Keep the file usable if the run is killed
+}
+
+//--------------------------------------------------------------------------------------------------
+// Closing the JSON structure and the file
+//
+void ProfilerExport::deinit() {
+  if (!m_file.is_open())
+    return;
+
+  if (!m_csv) {
+    if (m_firstRow)
+      m_file << "{\n  \"frames\": []\n}\n";  // No frame was ever recorded
+    else
+      m_file << "\n  ]\n}\n";
+  }
+  m_file.close();
+  LOGI("Profile: %d frames written\n", m_row);
+}
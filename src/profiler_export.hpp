@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include "nvvk/profiler_vk.hpp"
+#include "shaders/host_device.h"
+
+/*
+
+ #Profile
+ Streams the per-frame profiler sections (Render, Tonemap, ...), the NVML GPU measures and the
+ render settings to a JSON or CSV file for regression tracking across drivers and scenes. The
+ format is picked from the file extension (.csv, everything else is JSON). Rows are written as
+ they are recorded, nothing is accumulated in memory.
+
+ * Usage
+  - init with the output filename (--profile-out); does nothing when the name is empty
+  - record once per frame, after profiler.endFrame()
+  - deinit closes the JSON structure and the file
+
+*/
+class ProfilerExport {
+public:
+  void init(const std::string& filename);
+  void record(nvvk::ProfilerVK& profiler, const RtxState& state);
+  void deinit();
+
+  bool active() const {
+    return m_file.is_open();
+  }
+
+private:
+  void writeHeader(const RtxState& state);
+
+  std::ofstream m_file;
+  bool          m_csv{false};        // CSV instead of JSON
+  bool          m_firstRow{true};    // Header not written yet / no comma before the first JSON row
+  uint32_t      m_row{0};            // Rows written, for the periodic flush
+  std::chrono::high_resolution_clock::time_point m_startTime;
+};
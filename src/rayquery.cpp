@@ -73,18 +73,71 @@ void RayQuery::create(const VkExtent2D& size, const std::vector<VkDescriptorSetL
   layout_info.pSetLayouts            = rtDescSetLayouts.data();
   vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_pipelineLayout);
 
+  createPipeline();
+  timer.print();
+}
+
+//--------------------------------------------------------------------------------------------------
+// The compute pipeline, specializing RAY_STATISTICS (id 0, #Stats), DEBUG_FEATURES (id 1),
+// PBR_MODE (id 2, #Variants) and HALF_PRECISION (id 3, #HalfPrec) so the counter atomics, the
+// debug/heatmap instrumentation, the unused BRDF model and the compensated accumulation
+// compile out
+//
+void RayQuery::createPipeline() {
+  vkDestroyPipeline(m_device, m_pipeline, nullptr);
+
+  std::array<int32_t, 4> specData{m_rayStatistics ? 1 : 0, m_debugFeatures ? 1 : 0, m_pbrMode, m_halfPrecision ? 1 : 0};
+  std::array<VkSpecializationMapEntry, 4> specEntries{{{0, 0, sizeof(int32_t)},
+                                                       {1, 1 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {2, 2 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {3, 3 * sizeof(int32_t), sizeof(int32_t)}}};
+  VkSpecializationInfo specInfo{static_cast<uint32_t>(specEntries.size()), specEntries.data(), sizeof(specData),
+                                specData.data()};
+
   VkComputePipelineCreateInfo computePipelineCreateInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
-  computePipelineCreateInfo.layout       = m_pipelineLayout;
-  computePipelineCreateInfo.stage.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computePipelineCreateInfo.layout                     = m_pipelineLayout;
+  computePipelineCreateInfo.stage.sType                = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   computePipelineCreateInfo.stage.module = nvvk::createShaderModule(m_device, pathtrace_comp, sizeof(pathtrace_comp));
   computePipelineCreateInfo.stage.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
   computePipelineCreateInfo.stage.pName  = "main";
+  computePipelineCreateInfo.stage.pSpecializationInfo = &specInfo;
 
-  vkCreateComputePipelines(m_device, {}, 1, &computePipelineCreateInfo, nullptr, &m_pipeline);
+  vkCreateComputePipelines(m_device, m_pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_pipeline);
 
   m_debug.setObjectName(m_pipeline, "RayQuery");
   vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
-  timer.print();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Stats : toggle the ray counters; rebuilds the pipeline with a new specialization constant
+//
+void RayQuery::useRayStatistics(bool enable) {
+  m_rayStatistics = enable;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipeline();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Variants : select the debug-stripped / BRDF-fixed pipeline variant; rebuilds only on change
+//
+void RayQuery::useShaderVariant(bool debugFeatures, int pbrMode) {
+  if (m_debugFeatures == debugFeatures && m_pbrMode == pbrMode)
+    return;
+  m_debugFeatures = debugFeatures;
+  m_pbrMode       = pbrMode;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipeline();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #HalfPrec : match the precision of the render targets; rebuilds only on change
+//
+void RayQuery::useHalfPrecision(bool enable) {
+  if (m_halfPrecision == enable)
+    return;
+  m_halfPrecision = enable;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipeline();
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -92,11 +145,12 @@ void RayQuery::create(const VkExtent2D& size, const std::vector<VkDescriptorSetL
 //
 #define GROUP_SIZE 8  // Same group size as in compute shader
 void RayQuery::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
-                   const std::vector<VkDescriptorSet>& descSets) {
+                   const std::vector<VkDescriptorSet>& descSets, const std::vector<uint32_t>& dynOffsets) {
   // Preparing for the compute shader
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0,
-                          static_cast<uint32_t>(descSets.size()), descSets.data(), 0, nullptr);
+                          static_cast<uint32_t>(descSets.size()), descSets.data(),
+                          static_cast<uint32_t>(dynOffsets.size()), dynOffsets.data());
 
   // Sending the push constant information
   vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RtxState), &m_state);
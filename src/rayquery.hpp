@@ -47,13 +47,21 @@ public:
   void              create(const VkExtent2D& size, const std::vector<VkDescriptorSetLayout>& rtDescSetLayouts,
                            Scene* scene) override;
   void              run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
-                        const std::vector<VkDescriptorSet>& descSets) override;
+                        const std::vector<VkDescriptorSet>& descSets, const std::vector<uint32_t>& dynOffsets) override;
+  void              useRayStatistics(bool enable);
+  void              useShaderVariant(bool debugFeatures, int pbrMode);
+  void              useHalfPrecision(bool enable);
   const std::string name() override {
     return std::string("RQ");
   }
 
 private:
-  uint32_t m_nbHit{0};
+  void createPipeline();
+
+  bool m_rayStatistics{false};  // #Stats : compile the counter atomics in
+  bool m_debugFeatures{false};  // #Variants : compile the debug/heatmap instrumentation in
+  int  m_pbrMode{0};            // #Variants : 0-Disney, 1-Gltf, folded at compile time
+  bool m_halfPrecision{false};  // #HalfPrec : compile the compensated accumulation in
 
 private:
   // Setup
@@ -42,11 +42,30 @@ void RenderOutput::setup(const VkDevice& device, const VkPhysicalDevice& physica
   m_queueIndex = familyIndex;
   m_debug.setup(device);
 
+  // #Denoise : exported memory for the buffers shared with Cuda
+  m_memAllocEx.init(device, physicalDevice);
+  m_allocEx.init(device, physicalDevice, &m_memAllocEx);
+
   m_offscreenDepthFormat = nvvk::findDepthFormat(physicalDevice);
 }
 
 void RenderOutput::destroy() {
   m_pAlloc->destroy(m_offscreenColor);
+  m_pAlloc->destroy(m_offscreenMoments);
+  m_pAlloc->destroy(m_offscreenReproj);
+  m_pAlloc->destroy(m_offscreenHistory);
+  m_pAlloc->destroy(m_offscreenDisplay);
+  m_pAlloc->destroy(m_offscreenResidual);
+  m_pAlloc->destroy(m_convergedCntBuffer);
+
+  for (auto& b : m_denoiseBufIn) {
+    m_allocEx.destroy(b);
+  }
+  m_allocEx.destroy(m_denoiseBufOut);
+  m_allocEx.destroy(m_denoiseBufFlow);
+  m_allocEx.destroy(m_denoiseBufPrev);
+  m_allocEx.deinit();
+  m_memAllocEx.deinit();
 
   vkDestroyPipeline(m_device, m_postPipeline, nullptr);
   vkDestroyPipelineLayout(m_device, m_postPipelineLayout, nullptr);
@@ -74,6 +93,19 @@ void RenderOutput::createOffscreenRender(const VkExtent2D& size) {
   if (m_offscreenColor.image != VK_NULL_HANDLE) {
     m_pAlloc->destroy(m_offscreenColor);
   }
+  if (m_offscreenMoments.image != VK_NULL_HANDLE) {
+    m_pAlloc->destroy(m_offscreenMoments);
+  }
+  if (m_offscreenReproj.image != VK_NULL_HANDLE) {
+    m_pAlloc->destroy(m_offscreenReproj);
+    m_pAlloc->destroy(m_offscreenHistory);
+  }
+  if (m_offscreenDisplay.image != VK_NULL_HANDLE) {
+    m_pAlloc->destroy(m_offscreenDisplay);
+  }
+  if (m_offscreenResidual.image != VK_NULL_HANDLE) {
+    m_pAlloc->destroy(m_offscreenResidual);
+  }
 
   // Creating the color image
   {
@@ -91,11 +123,117 @@ void RenderOutput::createOffscreenRender(const VkExtent2D& size) {
     m_offscreenColor.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
   }
 
+  // Creating the luminance moments image for adaptive sampling (see pathtrace shaders)
+  {
+    auto momentsCreateInfo = nvvk::makeImage2DCreateInfo(size, m_offscreenMomentsFormat, VK_IMAGE_USAGE_STORAGE_BIT);
+
+    nvvk::Image image = m_pAlloc->createImage(momentsCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, momentsCreateInfo);
+
+    m_offscreenMoments                        = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenMoments.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // #AsyncCompute : what the tonemapper samples while the path tracer owns the result image on
+  // the compute queue; refreshed once a frame by copyToDisplay. Same mip chain as the result
+  // image, so the auto exposure keeps working on the copy.
+  {
+    auto displayCreateInfo = nvvk::makeImage2DCreateInfo(
+      size, m_offscreenColorFormat,
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, true);
+
+    nvvk::Image image = m_pAlloc->createImage(displayCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, displayCreateInfo);
+
+    VkSamplerCreateInfo sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler.maxLod                            = FLT_MAX;
+    m_offscreenDisplay                        = m_pAlloc->createTexture(image, ivInfo, sampler);
+    m_offscreenDisplay.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // #HalfPrec : error carry of the compensated accumulation; a single pixel in full precision
+  // mode, only keeping the descriptor set valid
+  {
+    VkExtent2D residualSize = m_halfPrecision ? size : VkExtent2D{1, 1};
+    auto       residualCreateInfo =
+      nvvk::makeImage2DCreateInfo(residualSize, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT);
+
+    nvvk::Image image = m_pAlloc->createImage(residualCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, residualCreateInfo);
+
+    m_offscreenResidual                        = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenResidual.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // #Reproject : this frame's color+depth and the copy of the last completed frame, for
+  // warm-starting the accumulation after a camera move
+  {
+    auto reprojCreateInfo = nvvk::makeImage2DCreateInfo(size, m_offscreenColorFormat,
+                                                        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    nvvk::Image image = m_pAlloc->createImage(reprojCreateInfo);
+    NAME_VK(image.image);
+    VkImageViewCreateInfo ivInfo = nvvk::makeImageViewCreateInfo(image.image, reprojCreateInfo);
+    m_offscreenReproj            = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenReproj.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    auto historyCreateInfo = nvvk::makeImage2DCreateInfo(size, m_offscreenColorFormat,
+                                                         VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    image = m_pAlloc->createImage(historyCreateInfo);
+    NAME_VK(image.image);
+    ivInfo                                    = nvvk::makeImageViewCreateInfo(image.image, historyCreateInfo);
+    m_offscreenHistory                        = m_pAlloc->createTexture(image, ivInfo);
+    m_offscreenHistory.descriptor.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  }
+
+  // #Denoise : result and guide layers in exported memory, written by the path tracers and
+  // mapped by Cuda so the denoiser runs in place. Without a denoiser they shrink to a single
+  // pixel, only keeping the descriptor set valid.
+  {
+    for (auto& b : m_denoiseBufIn) {
+      m_allocEx.destroy(b);
+    }
+    m_allocEx.destroy(m_denoiseBufOut);
+    m_allocEx.destroy(m_denoiseBufFlow);
+    m_allocEx.destroy(m_denoiseBufPrev);
+
+    VkDeviceSize pixels = m_denoiseCapable ? static_cast<VkDeviceSize>(size.width) * size.height : 1;
+    VkDeviceSize bufSize = pixels * 4 * sizeof(float);
+    VkBufferUsageFlags usage{VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+                             | VK_BUFFER_USAGE_TRANSFER_SRC_BIT};
+    for (auto& b : m_denoiseBufIn) {
+      b = m_allocEx.createBuffer(bufSize, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+      NAME_VK(b.buffer);
+    }
+    m_denoiseBufOut = m_allocEx.createBuffer(bufSize, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+    NAME_VK(m_denoiseBufOut.buffer);
+    m_denoiseBufFlow = m_allocEx.createBuffer(pixels * 2 * sizeof(float), usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+    NAME_VK(m_denoiseBufFlow.buffer);
+    m_denoiseBufPrev = m_allocEx.createBuffer(bufSize, usage, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+    NAME_VK(m_denoiseBufPrev.buffer);
+  }
+
+  // Counter of converged pixels, read back on the host for the GUI
+  if (m_convergedCntBuffer.buffer == VK_NULL_HANDLE) {
+    m_convergedCntBuffer =
+      m_pAlloc->createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    NAME_VK(m_convergedCntBuffer.buffer);
+  }
+
   // Setting the image layout for both color and depth
   {
     nvvk::CommandPool genCmdBuf(m_device, m_queueIndex);
     auto              cmdBuf = genCmdBuf.createCommandBuffer();
     nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenMoments.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenDisplay.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenReproj.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenHistory.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    nvvk::cmdBarrierImageLayout(cmdBuf, m_offscreenResidual.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
+    vkCmdFillBuffer(cmdBuf, m_convergedCntBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
 
     genCmdBuf.submitAndWait(cmdBuf);
   }
@@ -149,16 +287,50 @@ void RenderOutput::createPostDescriptor() {
     {OutputBindings::eSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT});
   bind.addBinding({OutputBindings::eStore, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
                    VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eMoments, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eStats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eDenoiseRGB, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eDenoiseAlbedo, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eDenoiseNormal, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eDenoiseFlow, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eReproject, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eHistory, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
+  bind.addBinding({OutputBindings::eResidual, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1,
+                   VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR});
   m_postDescSetLayout = bind.createLayout(m_device);
   m_postDescPool      = bind.createPool(m_device);
   m_postDescSet       = nvvk::allocateDescriptorSet(m_device, m_postDescPool, m_postDescSetLayout);
 
   std::vector<VkWriteDescriptorSet> writes;
+  // #AsyncCompute : the tonemapper samples the display copy while the compute queue owns the result
   writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eSampler,
-                                     &m_offscreenColor.descriptor));  // This is use by the tonemapper
+                                     m_asyncDisplay ? &m_offscreenDisplay.descriptor
+                                                    : &m_offscreenColor.descriptor));  // This is use by the tonemapper
   writes.emplace_back(
     bind.makeWrite(m_postDescSet, OutputBindings::eStore,
                    &m_offscreenColor.descriptor));  // This will be used by the ray trace to write the image
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eMoments, &m_offscreenMoments.descriptor));
+  VkDescriptorBufferInfo statsDesc{m_convergedCntBuffer.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eStats, &statsDesc));
+  VkDescriptorBufferInfo rgbDesc{m_denoiseBufIn[0].buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo albedoDesc{m_denoiseBufIn[1].buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo normalDesc{m_denoiseBufIn[2].buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eDenoiseRGB, &rgbDesc));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eDenoiseAlbedo, &albedoDesc));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eDenoiseNormal, &normalDesc));
+  VkDescriptorBufferInfo flowDesc{m_denoiseBufFlow.buffer, 0, VK_WHOLE_SIZE};
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eDenoiseFlow, &flowDesc));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eReproject, &m_offscreenReproj.descriptor));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eHistory, &m_offscreenHistory.descriptor));
+  writes.emplace_back(bind.makeWrite(m_postDescSet, OutputBindings::eResidual, &m_offscreenResidual.descriptor));
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
 
@@ -175,12 +347,108 @@ void RenderOutput::run(VkCommandBuffer cmdBuf) {
   vkCmdDraw(cmdBuf, 3, 1, 0, 0);
 }
 
+//--------------------------------------------------------------------------------------------------
+// #Adaptive
+// Reads the number of pixels the path tracers skipped as converged (a few frames old, the buffer
+// is host visible and never fenced), then resets the counter for the frame being recorded.
+//
+uint32_t RenderOutput::fetchConvergedCount(VkCommandBuffer cmdBuf) {
+  uint32_t count = *static_cast<uint32_t*>(m_pAlloc->map(m_convergedCntBuffer));
+  m_pAlloc->unmap(m_convergedCntBuffer);
+
+  vkCmdFillBuffer(cmdBuf, m_convergedCntBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+  VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &mb,
+                       0, nullptr, 0, nullptr);
+
+  return count;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Reproject
+// The path tracers wrote this frame's color+depth into the reprojection image; copying it to the
+// history image once they are done gives the next frame a stable source to warp from.
+//
+void RenderOutput::copyToHistory(VkCommandBuffer cmdBuf) {
+  VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  mb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+
+  VkImageCopy region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.extent         = {m_size.width, m_size.height, 1};
+  vkCmdCopyImage(cmdBuf, m_offscreenReproj.image, VK_IMAGE_LAYOUT_GENERAL, m_offscreenHistory.image,
+                 VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+  mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &mb,
+                       0, nullptr, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #AsyncCompute
+// Switches the tonemapper input between the result image (single queue) and its display copy
+// (async compute). Call with the device idle, the descriptor set is rewritten in place.
+//
+void RenderOutput::setAsyncDisplay(bool enable) {
+  m_asyncDisplay = enable;
+  if (m_postDescSet == VK_NULL_HANDLE)
+    return;
+
+  nvvk::DescriptorSetBindings bind;
+  bind.addBinding(
+    {OutputBindings::eSampler, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT});
+  VkWriteDescriptorSet write = bind.makeWrite(m_postDescSet, OutputBindings::eSampler,
+                                              enable ? &m_offscreenDisplay.descriptor : &m_offscreenColor.descriptor);
+  vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #AsyncCompute
+// Copies the result image into the display image the tonemapper samples. The leading barrier
+// orders the copy after the previous frame's tonemap reads on the graphics queue, the trailing
+// one orders the tonemap submitted after it; the dependency on the compute dispatch is carried
+// by the timeline semaphores (see Simulator::submitAsyncCompute).
+//
+void RenderOutput::copyToDisplay(VkCommandBuffer cmdBuf) {
+  VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+  mb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR
+                         | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+
+  VkImageCopy region{};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.extent         = {m_size.width, m_size.height, 1};
+  vkCmdCopyImage(cmdBuf, m_offscreenColor.image, VK_IMAGE_LAYOUT_GENERAL, m_offscreenDisplay.image,
+                 VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+  mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &mb, 0, nullptr,
+                       0, nullptr);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Generating all pyramid images, the highest level is used for getting the average luminance
-// of the image, which is then use to auto-expose.
+// of the image, which is then use to auto-expose. With async compute the tonemapper samples the
+// display copy, so the pyramid is generated there.
 //
 void RenderOutput::genMipmap(VkCommandBuffer cmdBuf) {
   LABEL_SCOPE_VK(cmdBuf);
-  nvvk::cmdGenerateMipmaps(cmdBuf, m_offscreenColor.image, m_offscreenColorFormat, m_size, nvvk::mipLevels(m_size), 1,
+  const VkImage image = m_asyncDisplay ? m_offscreenDisplay.image : m_offscreenColor.image;
+  nvvk::cmdGenerateMipmaps(cmdBuf, image, m_offscreenColorFormat, m_size, nvvk::mipLevels(m_size), 1,
                            VK_IMAGE_LAYOUT_GENERAL);
 }
@@ -24,10 +24,13 @@
 
 #pragma once
 
+#include <array>
+
 #include "Image.h"
 #include "nvmath/nvmath.h"
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/memallocator_dedicated_vk.hpp"
 #include "nvvk/resourceallocator_vk.hpp"
 #include "shaders/host_device.h"
 
@@ -44,6 +47,7 @@ public:
     0,             // autoExposure;
     0.5f,          // Ywhite;  // Burning white
     0.5f,          // key;     // Log-average luminance
+    0,             // upscale; // #DynRes
   };
 
 public:
@@ -55,6 +59,33 @@ public:
   void run(VkCommandBuffer cmdBuf);
   void genMipmap(VkCommandBuffer cmdBuf);
 
+  // #Adaptive : returns the converged pixel count of a previous frame and resets the counter
+  uint32_t fetchConvergedCount(VkCommandBuffer cmdBuf);
+
+  // #Reproject : copies this frame's color+depth into the history image, once the render pass
+  // is done; the next frame can then warp it without racing the writes
+  void copyToHistory(VkCommandBuffer cmdBuf);
+
+  // #AsyncCompute : while on, the tonemapper samples the display image instead of the result
+  // image; copyToDisplay refreshes it once a frame, so the path tracer can already overwrite
+  // the result image while the graphics queue is still post-processing
+  void setAsyncDisplay(bool enable);
+  void copyToDisplay(VkCommandBuffer cmdBuf);
+
+  // #Denoise : when set before create()/update(), the result and guide buffers are allocated at
+  // full size in exported memory, so a denoiser can map them and work in place
+  void setDenoiseCapable(bool capable) {
+    m_denoiseCapable = capable;
+  }
+
+  // #HalfPrec : when set before create()/update(), the accumulation and its derived targets are
+  // RGBA16F instead of RGBA32F and the residual image is allocated at full size, halving the
+  // render-target bandwidth of the path-trace dispatch
+  void setHalfPrecision(bool enable) {
+    m_halfPrecision        = enable;
+    m_offscreenColorFormat = enable ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+  }
+
   VkDescriptorSetLayout getDescLayout() {
     return m_postDescSetLayout;
   }
@@ -64,6 +95,32 @@ public:
   nvvk::Texture GetFinalImage() const {
     return m_offscreenColor;
   }
+  // #Stream : readback source while async compute owns the result image; refreshed once a
+  // frame and only ever touched on the graphics queue
+  nvvk::Texture GetDisplayImage() const {
+    return m_offscreenDisplay;
+  }
+  // #HalfPrec : readbacks need to know the texel size of the accumulation target
+  VkFormat getColorFormat() const {
+    return m_offscreenColorFormat;
+  }
+  // #Denoise : buffers shared with Cuda (order: RGB, Albedo, Normal) and their allocator
+  const std::array<nvvk::Buffer, 3>& getDenoiseBuffersIn() const {
+    return m_denoiseBufIn;
+  }
+  const nvvk::Buffer& getDenoiseBufferOut() const {
+    return m_denoiseBufOut;
+  }
+  // #Denoise : motion vectors and previous denoised color, for the temporal model
+  const nvvk::Buffer& getDenoiseBufferFlow() const {
+    return m_denoiseBufFlow;
+  }
+  const nvvk::Buffer& getDenoiseBufferPrev() const {
+    return m_denoiseBufPrev;
+  }
+  nvvk::ExportResourceAllocator& getExportAllocator() {
+    return m_allocEx;
+  }
 
 private:
   void createOffscreenRender(const VkExtent2D& size);
@@ -76,8 +133,25 @@ private:
   VkPipeline            m_postPipeline{VK_NULL_HANDLE};
   VkPipelineLayout      m_postPipelineLayout{VK_NULL_HANDLE};
   nvvk::Texture         m_offscreenColor;
-  // VkFormat m_offscreenColorFormat{VkFormat::eR16G16B16A16Sfloat};  // Darkening the scene over 5000 iterations
+  nvvk::Texture         m_offscreenMoments;   // Luminance mean / M2 for adaptive sampling
+  nvvk::Texture         m_offscreenReproj;    // #Reproject : this frame's color + primary depth
+  nvvk::Texture         m_offscreenHistory;   // #Reproject : last completed frame, copy of the above
+  nvvk::Texture         m_offscreenDisplay;   // #AsyncCompute : tonemap source, copy of the result
+  nvvk::Texture         m_offscreenResidual;  // #HalfPrec : error carry of the compensated mean
+  bool                  m_asyncDisplay{false};
+  bool                  m_halfPrecision{false};
+  nvvk::Buffer          m_convergedCntBuffer; // Host visible counter of converged pixels
+
+  // #Denoise : result and guide layers written by the path tracers, in exported memory
+  std::array<nvvk::Buffer, 3> m_denoiseBufIn;   // RGB, Albedo, Normal
+  nvvk::Buffer                m_denoiseBufOut;
+  nvvk::Buffer                m_denoiseBufFlow; // Motion vectors (vec2 per pixel)
+  nvvk::Buffer                m_denoiseBufPrev; // Previous denoised color, temporal model
+  bool                        m_denoiseCapable{false};
+  // RGBA16F alone darkens the scene over 5000 iterations; #HalfPrec pairs it with the
+  // error-compensated accumulation instead (see setHalfPrecision)
   VkFormat m_offscreenColorFormat{VK_FORMAT_R32G32B32A32_SFLOAT};
+  VkFormat m_offscreenMomentsFormat{VK_FORMAT_R32G32_SFLOAT};
   VkFormat m_offscreenDepthFormat{VK_FORMAT_X8_D24_UNORM_PACK32};  // Will be replaced by best supported format
 
   // Setup
@@ -86,5 +160,9 @@ private:
   VkDevice                 m_device;
   uint32_t                 m_queueIndex;
 
+  // #Denoise : dedicated allocations with the export flag, for the Cuda interop
+  nvvk::DedicatedMemoryAllocator m_memAllocEx;
+  nvvk::ExportResourceAllocator  m_allocEx;
+
   VkExtent2D m_size{};
 };
@@ -32,13 +32,21 @@ public:
                      nvvk::ResourceAllocator* allocator)              = 0;
   virtual void destroy()                                              = 0;
   virtual void run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
-                   const std::vector<VkDescriptorSet>& extraDescSets) = 0;
+                   const std::vector<VkDescriptorSet>& extraDescSets,
+                   const std::vector<uint32_t>&        dynOffsets)           = 0;
   virtual void create(const VkExtent2D& size, const std::vector<VkDescriptorSetLayout>& extraDescSetsLayout,
                       Scene* _scene = nullptr)                        = 0;
   virtual const std::string name()                                    = 0;
+  // #Bindless : a renderer surviving a scene hot-swap refreshes what it keeps per scene
+  // (the pipelines and layouts stay valid); default is nothing kept
+  virtual void onSceneChange(Scene* /*scene*/) {}
   void                      setPushContants(const RtxState& state) {
     m_state = state;
   }
+  void setPipelineCache(VkPipelineCache cache) {
+    m_pipelineCache = cache;
+  }
 
-  RtxState m_state{};
+  RtxState        m_state{};
+  VkPipelineCache m_pipelineCache{VK_NULL_HANDLE};  // Shared, persisted cache (see pipeline_cache.hpp)
 };
@@ -79,7 +79,10 @@ void RtxPipeline::create(const VkExtent2D& size, const std::vector<VkDescriptorS
   MilliTimer timer;
   LOGI("Create RtxPipeline");
 
-  m_nbHit = 1;  // scene->getStat().nbMaterials;
+  // A single hit group is enough: the closest-hit shader only records the hit and all shading
+  // runs in the raygen (see pathtrace.rchit), so per-material hit groups and SBT record
+  // offsets would not move any work. Per-material shading coherence is what the #Wavefront
+  // renderer provides instead.
 
   createPipelineLayout(rtDescSetLayouts);
   createPipeline();
@@ -118,10 +121,23 @@ void RtxPipeline::createPipeline() {
   VkPipelineShaderStageCreateInfo stage{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
   stage.pName = "main";  // All the same entry point
 
+  // #Stats / #Variants / #HalfPrec : RAY_STATISTICS (id 0), DEBUG_FEATURES (id 1), PBR_MODE
+  // (id 2) and HALF_PRECISION (id 3); the counters, the debug/heatmap instrumentation, the
+  // unused BRDF model and the compensated accumulation compile out
+  std::array<int32_t, 4> specData{m_rayStatistics ? 1 : 0, m_debugFeatures ? 1 : 0, m_pbrMode, m_halfPrecision ? 1 : 0};
+  std::array<VkSpecializationMapEntry, 4> specEntries{{{0, 0, sizeof(int32_t)},
+                                                       {1, 1 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {2, 2 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {3, 3 * sizeof(int32_t), sizeof(int32_t)}}};
+  VkSpecializationInfo specInfo{static_cast<uint32_t>(specEntries.size()), specEntries.data(), sizeof(specData),
+                                specData.data()};
+
   // Raygen
-  stage.module    = nvvk::createShaderModule(m_device, pathtrace_rgen, sizeof(pathtrace_rgen));
-  stage.stage     = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-  stages[eRaygen] = stage;
+  stage.module              = nvvk::createShaderModule(m_device, pathtrace_rgen, sizeof(pathtrace_rgen));
+  stage.stage               = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
+  stage.pSpecializationInfo = &specInfo;
+  stages[eRaygen]           = stage;
+  stage.pSpecializationInfo = nullptr;
 
   // Miss
   stage.module  = nvvk::createShaderModule(m_device, pathtrace_rmiss, sizeof(pathtrace_rmiss));
@@ -140,9 +156,11 @@ void RtxPipeline::createPipeline() {
   stages[eClosestHit] = stage;
 
   // Hit Group - Any Hit
-  stage.module    = nvvk::createShaderModule(m_device, pathtrace_rahit, sizeof(pathtrace_rahit));
-  stage.stage     = VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
-  stages[eAnyHit] = stage;
+  stage.module              = nvvk::createShaderModule(m_device, pathtrace_rahit, sizeof(pathtrace_rahit));
+  stage.stage               = VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
+  stage.pSpecializationInfo = &specInfo;
+  stages[eAnyHit]           = stage;
+  stage.pSpecializationInfo = nullptr;
 
   // Shader groups
   std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
@@ -196,7 +214,7 @@ void RtxPipeline::createPipeline() {
     assert(result == VK_SUCCESS);
   }
 
-  vkCreateRayTracingPipelinesKHR(m_device, deferredOp, {}, 1, &rayPipelineInfo, nullptr, &m_rtPipeline);
+  vkCreateRayTracingPipelinesKHR(m_device, deferredOp, m_pipelineCache, 1, &rayPipelineInfo, nullptr, &m_rtPipeline);
 
   if (useDeferred) {
     // Query the maximum amount of concurrency and clamp to the desired maximum
@@ -233,12 +251,13 @@ void RtxPipeline::createPipeline() {
 // Ray Tracing the scene
 //
 void RtxPipeline::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
-                      const std::vector<VkDescriptorSet>& descSets) {
+                      const std::vector<VkDescriptorSet>& descSets, const std::vector<uint32_t>& dynOffsets) {
   LABEL_SCOPE_VK(cmdBuf);
 
   vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipeline);
   vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, m_rtPipelineLayout, 0,
-                          static_cast<uint32_t>(descSets.size()), descSets.data(), 0, nullptr);
+                          static_cast<uint32_t>(descSets.size()), descSets.data(),
+                          static_cast<uint32_t>(dynOffsets.size()), dynOffsets.data());
   vkCmdPushConstants(
     cmdBuf, m_rtPipelineLayout,
     VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, 0,
@@ -255,3 +274,33 @@ void RtxPipeline::useAnyHit(bool enable) {
   m_enableAnyhit = enable;
   createPipeline();
 }
+
+//--------------------------------------------------------------------------------------------------
+// #Stats : toggle the ray counters; rebuilds the pipeline with a new specialization constant
+//
+void RtxPipeline::useRayStatistics(bool enable) {
+  m_rayStatistics = enable;
+  createPipeline();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Variants : select the debug-stripped / BRDF-fixed pipeline variant; rebuilds only on change.
+// The rebuild reuses the deferred-operation parallel compile and the warm pipeline cache above.
+//
+void RtxPipeline::useShaderVariant(bool debugFeatures, int pbrMode) {
+  if (m_debugFeatures == debugFeatures && m_pbrMode == pbrMode)
+    return;
+  m_debugFeatures = debugFeatures;
+  m_pbrMode       = pbrMode;
+  createPipeline();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #HalfPrec : match the precision of the render targets; rebuilds only on change
+//
+void RtxPipeline::useHalfPrecision(bool enable) {
+  if (m_halfPrecision == enable)
+    return;
+  m_halfPrecision = enable;
+  createPipeline();
+}
@@ -25,9 +25,12 @@
 
 
 #include <sstream>
+#include <thread>
 
 #include "imgui/imgui_camera_widget.h"
+#include "nvh/alignment.hpp"
 #include "nvh/cameramanipulator.hpp"
+#include "nvh/parallel_work.hpp"
 #include "nvvk/buffers_vk.hpp"
 #include "nvvk/commands_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
@@ -35,7 +38,9 @@
 
 #include "shaders/host_device.h"
 #include "scene.hpp"
+#include "scene_cache.hpp"
 #include "shaders/compress.glsl"
+#include "texture_cache.hpp"
 #include "tiny_gltf.h"
 #include "tools.hpp"
 
@@ -49,6 +54,74 @@ void Scene::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice
   m_pAlloc = allocator;
   m_queue  = queue;
   m_debug.setup(device);
+
+  // Slot size of the camera ring, respecting the dynamic offset alignment
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(physicalDevice, &props);
+  m_camSlotSize = static_cast<uint32_t>(
+      nvh::align_up(sizeof(SceneCamera), props.limits.minUniformBufferOffsetAlignment));
+}
+
+//--------------------------------------------------------------------------------------------------
+// #LightAccel : build an alias table over the punctual lights so DirectLight can pick a light
+// proportionally to its estimated emitted power instead of uniformly. Same construction as the
+// environment alias map; the handful of lights makes the serial sweep a non-issue here.
+//
+static std::vector<LightAccel> buildLightAccel(const Light* lights, uint32_t nbLights)
+{
+  std::vector<LightAccel> accel(std::max(nbLights, 1u), LightAccel{0, 1.f, 1.f});
+  if(nbLights == 0)
+    return accel;  // single uniform entry, matching the dummy light
+
+  // Estimated power: luminance scaled by the solid angle the light emits into. Directional
+  // lights have no falloff and light the whole scene, treat them like point lights.
+  std::vector<float> power(nbLights);
+  double             sum = 0.0;
+  for(uint32_t i = 0; i < nbLights; ++i)
+  {
+    const Light& l         = lights[i];
+    const float  luminance = 0.2126f * l.color.x + 0.7152f * l.color.y + 0.0722f * l.color.z;
+    const float  angle = l.type == LightType_Spot ? 2.f * nvmath::nv_pi * (1.f - l.outerConeCos) : 4.f * nvmath::nv_pi;
+    power[i]               = std::max(luminance * l.intensity * angle, 1e-10f);  // keep dark lights selectable
+    sum += power[i];
+  }
+
+  // Ratio q between the power of the light and the average power, aliases to identity
+  const float inverseAverage = static_cast<float>(nbLights / sum);
+  for(uint32_t i = 0; i < nbLights; ++i)
+  {
+    accel[i].q     = power[i] * inverseAverage;
+    accel[i].alias = i;
+    accel[i].pdf   = static_cast<float>(power[i] / sum);
+  }
+
+  // Partition the lights: below-average ones from the beginning of the table, above-average
+  // ones from the end, then pair each low light with a high one absorbing its deficit
+  std::vector<uint32_t> partitionTable(nbLights);
+  uint32_t              s     = 0u;
+  uint32_t              large = nbLights;
+  for(uint32_t i = 0; i < nbLights; ++i)
+  {
+    if(accel[i].q < 1.f)
+      partitionTable[s++] = i;
+    else
+      partitionTable[--large] = i;
+  }
+
+  for(s = 0; s < large && large < nbLights; ++s)
+  {
+    const uint32_t smallIndex = partitionTable[s];
+    const uint32_t highIndex  = partitionTable[large];
+
+    accel[smallIndex].alias = highIndex;
+    accel[highIndex].q -= 1.f - accel[smallIndex].q;
+
+    // The high light has absorbed enough deficits, move on to the next one
+    if(accel[highIndex].q < 1.f)
+      large++;
+  }
+
+  return accel;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -57,6 +130,14 @@ void Scene::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice
 bool Scene::load(const std::string& filename)
 {
   destroy();
+
+  // #SceneCache : a valid sidecar skips the tinygltf parse and the attribute conversion entirely
+  if(loadCached(filename))
+    return true;
+
+  m_bake     = {};
+  m_bakeable = true;
+
   nvh::GltfScene gltf;
 
   tinygltf::Model tmodel;
@@ -64,6 +145,7 @@ bool Scene::load(const std::string& filename)
     return false;
 
   m_stats = gltf.getStatistics(tmodel);
+  trimStagingArena();
 
   // Extracting GLTF information to our format and adding, if missing, attributes such as tangent
   {
@@ -86,10 +168,12 @@ bool Scene::load(const std::string& filename)
   nvvk::CommandPool cmdBufGet(m_device, m_queue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_queue.queue);
   VkCommandBuffer   cmdBuf = cmdBufGet.createCommandBuffer();
 
-  // Create camera buffer
-  m_buffer[eCameraMat] = m_pAlloc->createBuffer(sizeof(SceneCamera), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  // Create camera buffer: a persistently mapped ring with one slot per frame in flight,
+  // updated with a plain memcpy and bound with a dynamic offset
+  m_buffer[eCameraMat] = m_pAlloc->createBuffer(m_camSlotSize * s_ringFrames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
   NAME_VK(m_buffer[eCameraMat].buffer);
+  m_camMapped = static_cast<uint8_t*>(m_pAlloc->map(m_buffer[eCameraMat]));
 
   createMaterialBuffer(cmdBuf, gltf);
   createLightBuffer(cmdBuf, gltf);
@@ -115,6 +199,12 @@ bool Scene::load(const std::string& filename)
   m_gltf.m_materials  = gltf.m_materials;
   m_gltf.m_dimensions = gltf.m_dimensions;
 
+  // #SceneCache : bake the sidecar from what was just uploaded. Embedded or broken images
+  // cannot be rebuilt from the #TexCache sidecars, those scenes keep going through the glTF.
+  if(m_bakeable)
+    bakeSceneCache(filename, gltf);
+  m_bake = {};
+
   return true;
 }
 
@@ -132,6 +222,7 @@ bool Scene::loadGltfScene(const std::string& filename, tinygltf::Model& tmodel)
   fs::path    fspath(filename);
   std::string extension = fspath.extension().string();
   m_sceneName           = fspath.stem().string();
+  m_sceneDir            = fspath.parent_path().string();
   if(extension == ".gltf")
   {
     // Loading the scene using tinygltf, but don't load textures with it
@@ -166,30 +257,313 @@ bool Scene::loadGltfScene(const std::string& filename, tinygltf::Model& tmodel)
   return true;
 }
 
+//--------------------------------------------------------------------------------------------------
+// #SceneCache
+// Loading the scene from the binary sidecar: everything is uploaded straight from the mapped
+// file and the textures come from their #TexCache sidecars, no tinygltf and no attribute
+// conversion. Returns false when the cache is missing, stale or incomplete, in which case the
+// regular glTF path runs and re-bakes it.
+//
+bool Scene::loadCached(const std::string& filename)
+{
+  SceneCache cache;
+  if(!cache.open(SceneCache::cachePath(filename), filename))
+    return false;
+
+  LOGI("Loading cached scene: %s", SceneCache::cachePath(filename).c_str());
+  MilliTimer timer;
+
+  fs::path fspath(filename);
+  m_sceneName = fspath.stem().string();
+  m_sceneDir  = fspath.parent_path().string();
+
+  // All texture sidecars must still be present; they are opened up-front so a missing one
+  // falls back to the glTF before any resource is created
+  std::vector<TextureCache> texCaches(cache.imageCount());
+  for(size_t i = 0; i < cache.imageCount(); i++)
+  {
+    const std::string uri = cache.string(cache.images()[i].uriOffset);
+    if(!texCaches[i].open(TextureCache::cachePath(m_sceneDir + "/" + uri)))
+    {
+      LOGW("SceneCache: missing texture cache for %s, falling back to glTF\n", uri.c_str());
+      return false;
+    }
+  }
+
+  // Rebuilding the pieces of the nvh scene consumed downstream: the TLAS instance flags, the
+  // instance transforms and the GUI statistics
+  m_gltf.m_primMeshes.resize(cache.primMeshCount());
+  m_primOffsets.resize(cache.primMeshCount());
+  for(size_t i = 0; i < cache.primMeshCount(); i++)
+  {
+    const SceneCache::PrimMesh& cpm = cache.primMeshes()[i];
+    nvh::GltfPrimMesh&          pm  = m_gltf.m_primMeshes[i];
+    pm.firstIndex                   = cpm.firstIndex;
+    pm.indexCount                   = cpm.indexCount;
+    pm.vertexOffset                 = cpm.vertexOffset;
+    pm.vertexCount                  = cpm.vertexCount;
+    pm.materialIndex                = cpm.materialIndex;
+    pm.posMin                       = cpm.posMin;
+    pm.posMax                       = cpm.posMax;
+    pm.name                         = cache.string(cpm.nameOffset);
+    m_primOffsets[i]                = {cpm.vertexByteOffset, cpm.indexByteOffset};
+  }
+
+  m_gltf.m_nodes.resize(cache.nodeCount());
+  for(size_t i = 0; i < cache.nodeCount(); i++)
+  {
+    m_gltf.m_nodes[i].worldMatrix = cache.nodes()[i].worldMatrix;
+    m_gltf.m_nodes[i].primMesh    = cache.nodes()[i].primMesh;
+  }
+
+  // Only the fields createTopLevelAS reads for the instance flags are restored
+  m_gltf.m_materials.resize(cache.materialCount());
+  for(size_t i = 0; i < cache.materialCount(); i++)
+  {
+    const GltfShadeMaterial& smat          = cache.materials()[i];
+    m_gltf.m_materials[i].alphaMode        = smat.alphaMode;
+    m_gltf.m_materials[i].doubleSided      = smat.doubleSided;
+    m_gltf.m_materials[i].baseColorFactor  = smat.pbrBaseColorFactor;
+    m_gltf.m_materials[i].baseColorTexture = smat.pbrBaseColorTexture;
+  }
+
+  m_gltf.m_dimensions.min    = cache.dimensions().min;
+  m_gltf.m_dimensions.max    = cache.dimensions().max;
+  m_gltf.m_dimensions.size   = cache.dimensions().size;
+  m_gltf.m_dimensions.center = cache.dimensions().center;
+  m_gltf.m_dimensions.radius = cache.dimensions().radius;
+
+  m_stats.nbCameras         = cache.stats().nbCameras;
+  m_stats.nbImages          = cache.stats().nbImages;
+  m_stats.imageMem          = cache.stats().imageMem;
+  m_stats.nbTextures        = cache.stats().nbTextures;
+  m_stats.nbMaterials       = cache.stats().nbMaterials;
+  m_stats.nbSamplers        = cache.stats().nbSamplers;
+  m_stats.nbNodes           = cache.stats().nbNodes;
+  m_stats.nbMeshes          = cache.stats().nbMeshes;
+  m_stats.nbLights          = cache.stats().nbLights;
+  m_stats.nbTriangles       = cache.stats().nbTriangles;
+  m_stats.nbUniqueTriangles = cache.stats().nbUniqueTriangles;
+
+  trimStagingArena();
+
+  // Setting all cached cameras, same as setCameraFromScene
+  ImGuiH::SetCameraJsonFile(m_sceneName);
+  if(cache.cameraCount() > 0)
+  {
+    const SceneCache::Camera& c = cache.cameras()[0];
+    CameraManip.setCamera({c.eye, c.center, c.up, (float)rad2deg(c.yfov)});
+    ImGuiH::SetHomeCamera({c.eye, c.center, c.up, (float)rad2deg(c.yfov)});
+
+    for(size_t i = 0; i < cache.cameraCount(); i++)
+    {
+      const SceneCache::Camera& cam = cache.cameras()[i];
+      ImGuiH::AddCamera({cam.eye, cam.center, cam.up, (float)rad2deg(cam.yfov)});
+    }
+  }
+  else
+  {
+    CameraManip.fit(m_gltf.m_dimensions.min, m_gltf.m_dimensions.max, true);
+  }
+  m_camera.nbLights = static_cast<int>(cache.nbLights());
+
+  LOGI("Create Buffers\n");
+  nvvk::CommandPool cmdBufGet(m_device, m_queue.familyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, m_queue.queue);
+  VkCommandBuffer   cmdBuf = cmdBufGet.createCommandBuffer();
+
+  // Create camera buffer: a persistently mapped ring with one slot per frame in flight,
+  // updated with a plain memcpy and bound with a dynamic offset
+  m_buffer[eCameraMat] = m_pAlloc->createBuffer(m_camSlotSize * s_ringFrames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  NAME_VK(m_buffer[eCameraMat].buffer);
+  m_camMapped = static_cast<uint8_t*>(m_pAlloc->map(m_buffer[eCameraMat]));
+
+  // Materials and lights, staged directly from the mapped file
+  m_buffer[eMaterial] = m_pAlloc->createBuffer(cmdBuf, cache.materialCount() * sizeof(GltfShadeMaterial),
+                                               cache.materials(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_buffer[eMaterial].buffer);
+  m_buffer[eLights] =
+      m_pAlloc->createBuffer(cmdBuf, cache.lightCount() * sizeof(Light), cache.lights(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_buffer[eLights].buffer);
+
+  // #LightAccel : the alias table is cheap to rebuild from the cached lights, it is not baked
+  std::vector<LightAccel> lightAccel = buildLightAccel(cache.lights(), static_cast<uint32_t>(cache.nbLights()));
+  m_buffer[eLightAccel] = m_pAlloc->createBuffer(cmdBuf, lightAccel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_buffer[eLightAccel].buffer);
+
+  // #MultiView : per-view cameras of the sensor rig, refreshed in place each frame
+  m_buffer[eViews] = m_pAlloc->createBuffer(MULTIVIEW_MAX_VIEWS * sizeof(SceneView),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  NAME_VK(m_buffer[eViews].buffer);
+
+  // Textures from the #TexCache sidecars with the cached sampler configuration
+  if(cache.textureCount() == 0)
+  {
+    // No textures, make a dummy one as the descriptor array cannot be empty
+    m_defaultTextures.push_back(m_textures.size());
+    std::array<uint8_t, 4> white = {255, 255, 255, 255};
+    VkSamplerCreateInfo    sampler{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    m_textures.emplace_back(m_pAlloc->createTexture(cmdBuf, 4, white.data(), nvvk::makeImage2DCreateInfo(VkExtent2D{1, 1}), sampler));
+    m_debug.setObjectName(m_textures.back().image, "dummy");
+  }
+  else
+  {
+    m_images.reserve(cache.imageCount());
+    for(size_t i = 0; i < cache.imageCount(); i++)
+      addCacheImage(cmdBuf, texCaches[i], i);
+
+    m_textures.reserve(cache.textureCount());
+    for(size_t i = 0; i < cache.textureCount(); i++)
+    {
+      const SceneCache::Texture& ctex = cache.textures()[i];
+      VkSamplerCreateInfo        samplerCreateInfo{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+      samplerCreateInfo.magFilter    = static_cast<VkFilter>(ctex.magFilter);
+      samplerCreateInfo.minFilter    = static_cast<VkFilter>(ctex.minFilter);
+      samplerCreateInfo.mipmapMode   = static_cast<VkSamplerMipmapMode>(ctex.mipmapMode);
+      samplerCreateInfo.addressModeU = static_cast<VkSamplerAddressMode>(ctex.addressModeU);
+      samplerCreateInfo.addressModeV = static_cast<VkSamplerAddressMode>(ctex.addressModeV);
+      samplerCreateInfo.maxLod       = ctex.maxLod;
+
+      std::pair<nvvk::Image, VkImageCreateInfo>& image  = m_images[ctex.imageIndex];
+      VkImageViewCreateInfo                      ivInfo = nvvk::makeImageViewCreateInfo(image.first.image, image.second);
+      m_textures.emplace_back(m_pAlloc->createTexture(image.first, ivInfo, samplerCreateInfo));
+
+      NAME_IDX_VK(m_textures[i].image, i);
+    }
+  }
+
+  // The packed vertex and index buffers, staged directly from the mapped file
+  m_buffer[eVertexData] = m_pAlloc->createBuffer(cmdBuf, cache.vertexCount() * sizeof(VertexAttributes), cache.vertices(),
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                     | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  NAME_VK(m_buffer[eVertexData].buffer);
+
+  m_buffer[eIndexData] = m_pAlloc->createBuffer(cmdBuf, cache.indexCount() * sizeof(uint32_t), cache.indices(),
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                    | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  NAME_VK(m_buffer[eIndexData].buffer);
+
+  createInstanceDataBuffer(cmdBuf, m_gltf);
+
+  // Finalizing the command buffer - upload data to GPU
+  LOGI(" <Finalize>");
+  cmdBufGet.submitAndWait(cmdBuf);
+  m_pAlloc->finalizeAndReleaseStaging();
+
+  // Descriptor set for all elements
+  createDescriptorSet(m_gltf);
+
+  timer.print();
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #SceneCache
+// Writing the sidecar from everything collected along the glTF load
+//
+void Scene::bakeSceneCache(const std::string& filename, const nvh::GltfScene& gltf)
+{
+  for(size_t i = 0; i < gltf.m_primMeshes.size(); i++)
+  {
+    const nvh::GltfPrimMesh& pm = gltf.m_primMeshes[i];
+    SceneCache::PrimMesh     cpm{};
+    cpm.firstIndex       = pm.firstIndex;
+    cpm.indexCount       = pm.indexCount;
+    cpm.vertexOffset     = pm.vertexOffset;
+    cpm.vertexCount      = pm.vertexCount;
+    cpm.materialIndex    = pm.materialIndex;
+    cpm.posMin           = pm.posMin;
+    cpm.posMax           = pm.posMax;
+    cpm.nameOffset       = m_bake.addString(pm.name);
+    cpm.vertexByteOffset = m_primOffsets[i].vertexByteOffset;
+    cpm.indexByteOffset  = m_primOffsets[i].indexByteOffset;
+    m_bake.primMeshes.emplace_back(cpm);
+  }
+
+  for(const auto& node : gltf.m_nodes)
+  {
+    SceneCache::Node cnode{};
+    cnode.worldMatrix = node.worldMatrix;
+    cnode.primMesh    = node.primMesh;
+    m_bake.nodes.emplace_back(cnode);
+  }
+
+  for(const auto& c : gltf.m_cameras)
+    m_bake.cameras.emplace_back(SceneCache::Camera{c.eye, c.center, c.up, static_cast<float>(c.cam.perspective.yfov)});
+
+  m_bake.stats.nbCameras         = m_stats.nbCameras;
+  m_bake.stats.nbImages          = m_stats.nbImages;
+  m_bake.stats.imageMem          = m_stats.imageMem;
+  m_bake.stats.nbTextures        = m_stats.nbTextures;
+  m_bake.stats.nbMaterials       = m_stats.nbMaterials;
+  m_bake.stats.nbSamplers        = m_stats.nbSamplers;
+  m_bake.stats.nbNodes           = m_stats.nbNodes;
+  m_bake.stats.nbMeshes          = m_stats.nbMeshes;
+  m_bake.stats.nbLights          = m_stats.nbLights;
+  m_bake.stats.nbTriangles       = m_stats.nbTriangles;
+  m_bake.stats.nbUniqueTriangles = m_stats.nbUniqueTriangles;
+
+  m_bake.dimensions.min    = gltf.m_dimensions.min;
+  m_bake.dimensions.max    = gltf.m_dimensions.max;
+  m_bake.dimensions.size   = gltf.m_dimensions.size;
+  m_bake.dimensions.center = gltf.m_dimensions.center;
+  m_bake.dimensions.radius = gltf.m_dimensions.radius;
+
+  LOGI("Baking scene cache: %s", SceneCache::cachePath(filename).c_str());
+  MilliTimer timer;
+  SceneCache::bake(SceneCache::cachePath(filename), m_bake);
+  timer.print();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #StagingArena
+// The staging blocks persist across loads (setFreeUnusedOnRelease(false) in Simulator::setup),
+// so hot-swapping scenes reuses the same pinned memory. When the retained arena is far larger
+// than what this scene uploads - estimated from the statistics - the unused blocks are given
+// back instead of staying pinned for the rest of the session.
+//
+void Scene::trimStagingArena()
+{
+  VkDeviceSize allocated{0};
+  VkDeviceSize used{0};
+  m_pAlloc->getStaging()->getUtilization(allocated, used);
+
+  const VkDeviceSize uploadEstimate = m_stats.imageMem + m_stats.nbUniqueTriangles * 3 * sizeof(VertexAttributes)
+                                      + m_stats.nbTriangles * 3 * sizeof(uint32_t);
+  if(allocated > 2 * uploadEstimate)
+    m_pAlloc->getStaging()->freeUnused();
+}
+
 //--------------------------------------------------------------------------------------------------
 // Information per instance/geometry, the material it uses, and also the pointer to the vertex
 // and index buffers
 //
 void Scene::createInstanceDataBuffer(VkCommandBuffer cmdBuf, nvh::GltfScene& gltf)
 {
-  std::vector<InstanceData> instData;
-  uint32_t                  cnt{0};
+  // The device address of each primitive is the base address of the packed buffer plus its
+  // byte offset, so only two addresses are ever queried regardless of the number of primitives.
+  VkDeviceAddress vertexBase = nvvk::getBufferDeviceAddress(m_device, m_buffer[eVertexData].buffer);
+  VkDeviceAddress indexBase  = nvvk::getBufferDeviceAddress(m_device, m_buffer[eIndexData].buffer);
+
+  uint32_t cnt{0};
+  m_instData.clear();
   for(auto& primMesh : gltf.m_primMeshes)
   {
     InstanceData data;
-    data.indexAddress  = nvvk::getBufferDeviceAddress(m_device, m_buffers[eIndex][cnt].buffer);
-    data.vertexAddress = nvvk::getBufferDeviceAddress(m_device, m_buffers[eVertex][cnt].buffer);
+    data.indexAddress  = indexBase + m_primOffsets[cnt].indexByteOffset;
+    data.vertexAddress = vertexBase + m_primOffsets[cnt].vertexByteOffset;
     data.materialIndex = primMesh.materialIndex;
-    instData.emplace_back(data);
+    m_instData.emplace_back(data);
     cnt++;
   }
-  m_buffer[eInstData] = m_pAlloc->createBuffer(cmdBuf, instData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  m_buffer[eInstData] = m_pAlloc->createBuffer(cmdBuf, m_instData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
   NAME_VK(m_buffer[eInstData].buffer);
 }
 
 //--------------------------------------------------------------------------------------------------
-// Creating a buffer per primitive mesh (BLAS) containing all Vertex (pos, nrm, .. )
-// and a buffer of index.
+// Creating a single vertex buffer and a single index buffer holding all primitive meshes,
+// the offsets of each primitive are kept in m_primOffsets. One allocation instead of one per
+// primitive avoids running in the memory allocation limit (4096) on large scenes.
 //
 // We are compressing the data, because it makes a huge difference in the raytracer when accessing the
 // data.
@@ -204,84 +578,101 @@ void Scene::createVertexBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& glt
   LOGI(" - Create %d Vertex Buffers", gltf.m_primMeshes.size());
   MilliTimer timer;
 
-  std::vector<VertexAttributes> vertex{};
-  std::vector<uint32_t>         indices;
-
+  auto nb_meshes = static_cast<uint32_t>(gltf.m_primMeshes.size());
 
-  std::unordered_map<std::string, nvvk::Buffer> m_cachePrimitive;
-
-  uint32_t prim_idx{0};
-  for(const nvh::GltfPrimMesh& primMesh : gltf.m_primMeshes)
+  // Primitives sharing the same vertex range are stored only once; find for each primitive
+  // the one which owns the conversion (first primitive with this key).
+  std::unordered_map<std::string, uint32_t> canonicalPrim;
+  std::vector<uint32_t>                     primSource(nb_meshes);
+  for(uint32_t prim_idx = 0; prim_idx < nb_meshes; prim_idx++)
   {
+    const nvh::GltfPrimMesh& primMesh = gltf.m_primMeshes[prim_idx];
+    std::stringstream        o;
+    o << primMesh.vertexOffset << ":";
+    o << primMesh.vertexCount;
+    primSource[prim_idx] = canonicalPrim.emplace(o.str(), prim_idx).first->second;
+  }
 
-    // Create a key to find a primitive that is already uploaded
-    std::stringstream o;
-    {
-      o << primMesh.vertexOffset << ":";
-      o << primMesh.vertexCount;
-    }
-    std::string key           = o.str();
-    bool        primProcessed = false;
-
-    nvvk::Buffer v_buffer;
-    auto         it = m_cachePrimitive.find(key);
-    if(it == m_cachePrimitive.end())
+  // Layout of the packed buffers: prefix sums of the unique vertex ranges and of all index
+  // ranges, in bytes, kept in m_primOffsets for the instance data and the BLAS build.
+  m_primOffsets.resize(nb_meshes);
+  size_t totalVertices{0};
+  size_t totalIndices{0};
+  for(uint32_t prim_idx = 0; prim_idx < nb_meshes; prim_idx++)
+  {
+    const nvh::GltfPrimMesh& primMesh = gltf.m_primMeshes[prim_idx];
+    if(primSource[prim_idx] == prim_idx)
     {
-
-      vertex.resize(primMesh.vertexCount);
-      for(size_t v_ctx = 0; v_ctx < primMesh.vertexCount; v_ctx++)
-      {
-        size_t           idx = primMesh.vertexOffset + v_ctx;
-        VertexAttributes v{};
-        v.position = gltf.m_positions[idx];
-        v.normal   = compress_unit_vec(gltf.m_normals[idx]);
-        v.tangent  = compress_unit_vec(nvmath::vec3f(gltf.m_tangents[idx]));  // See .w encoding below
-        v.texcoord = gltf.m_texcoords0[idx];
-        v.color    = packUnorm4x8(gltf.m_colors0[idx]);
-
-        // Encode to the Less-Significant-Bit the handiness of the tangent
-        // Not a significant change on the UV to make a visual difference
-        //auto     uintBitsToFloat = [](uint32_t a) -> float { return *(float*)&(a); };
-        //auto     floatBitsToUint = [](float a) -> uint32_t { return *(uint32_t*)&(a); };
-        uint32_t value = floatBitsToUint(v.texcoord.y);
-        if(gltf.m_tangents[idx].w > 0)
-          value |= 1;  // set bit, H == +1
-        else
-          value &= ~1;  // clear bit, H == -1
-        v.texcoord.y = uintBitsToFloat(value);
-
-        vertex[v_ctx] = std::move(v);
-      }
-      v_buffer = m_pAlloc->createBuffer(cmdBuf, vertex,
-                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
-                                            | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
-      NAME_IDX_VK(v_buffer.buffer, prim_idx);
-      m_cachePrimitive[key] = v_buffer;
+      m_primOffsets[prim_idx].vertexByteOffset = totalVertices * sizeof(VertexAttributes);
+      totalVertices += primMesh.vertexCount;
     }
     else
     {
-      v_buffer = it->second;
-    }
-
-    // Buffer of indices
-    indices.resize(primMesh.indexCount);
-    for(size_t idx = 0; idx < primMesh.indexCount; idx++)
-    {
-      indices[idx] = gltf.m_indices[idx + primMesh.firstIndex];
+      m_primOffsets[prim_idx].vertexByteOffset = m_primOffsets[primSource[prim_idx]].vertexByteOffset;
     }
+    m_primOffsets[prim_idx].indexByteOffset = totalIndices * sizeof(uint32_t);
+    totalIndices += primMesh.indexCount;
+  }
 
-    nvvk::Buffer i_buffer = m_pAlloc->createBuffer(cmdBuf, indices,
-                                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
-                                                       | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
-
-    m_buffers[eVertex].push_back(v_buffer);
-    NAME_IDX_VK(v_buffer.buffer, prim_idx);
-
-    m_buffers[eIndex].push_back(i_buffer);
-    NAME_IDX_VK(i_buffer.buffer, prim_idx);
+  // Compressing the attributes is by far the most expensive part of the conversion; it runs
+  // per-primitive on the thread pool, each primitive writing its slice of the packed arrays.
+  // The arrays live in m_bake so the #SceneCache sidecar stores them as-is.
+  std::vector<VertexAttributes>& allVertices = m_bake.vertices;
+  std::vector<uint32_t>&         allIndices  = m_bake.indices;
+  allVertices.resize(totalVertices);
+  allIndices.resize(totalIndices);
+  nvh::parallel_batches<1>(  // batch of 1: primitives vary widely in size
+      nb_meshes,
+      [&](uint64_t prim_idx) {
+        const nvh::GltfPrimMesh& primMesh = gltf.m_primMeshes[prim_idx];
+
+        if(primSource[prim_idx] == prim_idx)  // not sharing the vertices of an earlier primitive
+        {
+          VertexAttributes* vertex = &allVertices[m_primOffsets[prim_idx].vertexByteOffset / sizeof(VertexAttributes)];
+          for(size_t v_ctx = 0; v_ctx < primMesh.vertexCount; v_ctx++)
+          {
+            size_t           idx = primMesh.vertexOffset + v_ctx;
+            VertexAttributes v{};
+            v.position = gltf.m_positions[idx];
+            v.normal   = compress_unit_vec(gltf.m_normals[idx]);
+            v.tangent  = compress_unit_vec(nvmath::vec3f(gltf.m_tangents[idx]));  // See .w encoding below
+            v.texcoord = gltf.m_texcoords0[idx];
+            v.color    = packUnorm4x8(gltf.m_colors0[idx]);
+
+            // Encode to the Less-Significant-Bit the handiness of the tangent
+            // Not a significant change on the UV to make a visual difference
+            //auto     uintBitsToFloat = [](uint32_t a) -> float { return *(float*)&(a); };
+            //auto     floatBitsToUint = [](float a) -> uint32_t { return *(uint32_t*)&(a); };
+            uint32_t value = floatBitsToUint(v.texcoord.y);
+            if(gltf.m_tangents[idx].w > 0)
+              value |= 1;  // set bit, H == +1
+            else
+              value &= ~1;  // clear bit, H == -1
+            v.texcoord.y = uintBitsToFloat(value);
+
+            vertex[v_ctx] = std::move(v);
+          }
+        }
+
+        uint32_t* indices = &allIndices[m_primOffsets[prim_idx].indexByteOffset / sizeof(uint32_t)];
+        for(size_t idx = 0; idx < primMesh.indexCount; idx++)
+        {
+          indices[idx] = gltf.m_indices[idx + primMesh.firstIndex];
+        }
+      },
+      std::thread::hardware_concurrency());
+
+  // Upload of the two packed buffers; a single allocation each
+  m_buffer[eVertexData] = m_pAlloc->createBuffer(cmdBuf, allVertices,
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                     | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  NAME_VK(m_buffer[eVertexData].buffer);
+
+  m_buffer[eIndexData] = m_pAlloc->createBuffer(cmdBuf, allIndices,
+                                                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+                                                    | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR);
+  NAME_VK(m_buffer[eIndexData].buffer);
 
-    prim_idx++;
-  }
   timer.print();
 }
 
@@ -338,10 +729,23 @@ void Scene::createLightBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& gltf
     all_lights.emplace_back(l);
   }
 
+  m_bake.nbLights = static_cast<uint32_t>(all_lights.size());  // #SceneCache : without the dummy
+
+  // #LightAccel : alias table to pick lights proportionally to their estimated power
+  std::vector<LightAccel> lightAccel = buildLightAccel(all_lights.data(), m_bake.nbLights);
+
   if(all_lights.empty())  // Cannot be null
     all_lights.emplace_back(Light{});
   m_buffer[eLights] = m_pAlloc->createBuffer(cmdBuf, all_lights, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
   NAME_VK(m_buffer[eLights].buffer);
+  m_buffer[eLightAccel] = m_pAlloc->createBuffer(cmdBuf, lightAccel, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_buffer[eLightAccel].buffer);
+  m_bake.lights = std::move(all_lights);
+
+  // #MultiView : per-view cameras of the sensor rig, refreshed in place each frame
+  m_buffer[eViews] = m_pAlloc->createBuffer(MULTIVIEW_MAX_VIEWS * sizeof(SceneView),
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  NAME_VK(m_buffer[eViews].buffer);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -396,6 +800,7 @@ void Scene::createMaterialBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& g
   }
   m_buffer[eMaterial] = m_pAlloc->createBuffer(cmdBuf, shadeMaterials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
   NAME_VK(m_buffer[eMaterial].buffer);
+  m_bake.materials = std::move(shadeMaterials);  // #SceneCache
   timer.print();
 }
 
@@ -404,6 +809,11 @@ void Scene::createMaterialBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& g
 //
 void Scene::destroy()
 {
+  if(m_camMapped != nullptr)
+  {
+    m_pAlloc->unmap(m_buffer[eCameraMat]);
+    m_camMapped = nullptr;
+  }
 
   for(auto& buffer : m_buffer)
   {
@@ -411,20 +821,8 @@ void Scene::destroy()
     buffer = {};
   }
 
-  // This is to avoid deleting twice a buffer, the vector
-  // of vertex buffer can be sharing buffers
-  std::unordered_map<VkBuffer, nvvk::Buffer> map_bv;
-  for(auto& buffers : m_buffers[eVertex])
-    map_bv[buffers.buffer] = buffers;
-  for(auto& bv : map_bv)
-    m_pAlloc->destroy(bv.second);
-  m_buffers[eVertex].clear();
-
-  for(auto& buffers : m_buffers[eIndex])
-  {
-    m_pAlloc->destroy(buffers);
-  }
-  m_buffers[eIndex].clear();
+  m_primOffsets.clear();
+  m_instData.clear();
 
   for(auto& i : m_images)
   {
@@ -449,11 +847,22 @@ void Scene::destroy()
   m_textures.clear();
 
 
+  // #Bindless : the descriptor pool, layout and set survive the scene; the layout is fixed
+  // for the process lifetime and the next load only rewrites the descriptors
+
+  m_gltf  = {};
+  m_stats = {};
+}
+
+//--------------------------------------------------------------------------------------------------
+// Final teardown: the per-scene resources plus the process-lifetime descriptors (#Bindless)
+//
+void Scene::deinit()
+{
+  destroy();
+
   vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
   vkDestroyDescriptorSetLayout(m_device, m_descSetLayout, nullptr);
-
-  m_gltf          = {};
-  m_stats         = {};
   m_descPool      = VkDescriptorPool();
   m_descSetLayout = VkDescriptorSetLayout();
   m_descSet       = VkDescriptorSet();
@@ -500,6 +909,61 @@ VkSamplerCreateInfo gltfSamplerToVulkan(tinygltf::Sampler& tsampler)
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// #TexCache
+// Creates an image from the compressed sidecar cache next to the source file; on first load the
+// cache is baked from the FreeImage-decoded pixels (mip chain + BC3). Subsequent loads map the
+// compressed payload and copy it level by level straight into staging - no decode, no mipmap
+// blits and a quarter of the RGBA8 VRAM.
+//
+bool Scene::createCachedTextureImage(VkCommandBuffer cmdBuf, tinygltf::Image& gltfimage, size_t idx)
+{
+  const std::string cacheFile = TextureCache::cachePath(m_sceneDir + "/" + gltfimage.uri);
+
+  TextureCache cache;
+  if(!cache.open(cacheFile))
+  {
+    if(gltfimage.width <= 0 || gltfimage.height <= 0 || gltfimage.image.empty())
+      return false;
+    if(!TextureCache::bake(cacheFile, gltfimage.image.data(), gltfimage.width, gltfimage.height))
+      return false;
+    if(!cache.open(cacheFile))
+      return false;
+  }
+
+  addCacheImage(cmdBuf, cache, idx);
+  return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #TexCache
+// Image creation from an opened cache: the compressed payload is copied level by level straight
+// into staging. Shared between the glTF load and the #SceneCache fast path.
+//
+void Scene::addCacheImage(VkCommandBuffer cmdBuf, const TextureCache& cache, size_t idx)
+{
+  VkImageCreateInfo imageCreateInfo =
+      nvvk::makeImage2DCreateInfo({cache.width(), cache.height()}, cache.format(), VK_IMAGE_USAGE_SAMPLED_BIT, true);
+  imageCreateInfo.mipLevels = static_cast<uint32_t>(cache.mips().size());
+
+  nvvk::Image image = m_pAlloc->createImage(imageCreateInfo);
+  NAME_IDX_VK(image.image, idx);
+
+  const VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, imageCreateInfo.mipLevels, 0, 1};
+  nvvk::cmdBarrierImageLayout(cmdBuf, image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+  for(uint32_t mip = 0; mip < imageCreateInfo.mipLevels; mip++)
+  {
+    const auto&              level = cache.mips()[mip];
+    VkImageSubresourceLayers subresource{VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+    m_pAlloc->getStaging()->cmdToImage(cmdBuf, image.image, VkOffset3D{0, 0, 0},
+                                       VkExtent3D{level.width, level.height, 1}, subresource, level.size, level.data);
+  }
+  nvvk::cmdBarrierImageLayout(cmdBuf, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                              VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, range);
+
+  m_images.emplace_back(image, imageCreateInfo);
+}
+
 //--------------------------------------------------------------------------------------------------
 // Uploading all textures and images to the GPU
 //
@@ -543,6 +1007,17 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
     size_t sourceImage = i;
 
     auto& gltfimage = gltfModel.images[sourceImage];
+
+    // #TexCache : external images go through the compressed sidecar cache (BC3 + mips)
+    if(!gltfimage.uri.empty() && createCachedTextureImage(cmdBuf, gltfimage, i))
+    {
+      m_bake.images.push_back({m_bake.addString(gltfimage.uri)});  // #SceneCache
+      continue;
+    }
+
+    // #SceneCache : this image has no sidecar to reload from, the scene cannot be cached
+    m_bakeable = false;
+
     if(gltfimage.width == -1 || gltfimage.height == -1 || gltfimage.image.empty())
     {
       // Image not present or incorrectly loaded (image.empty)
@@ -573,6 +1048,7 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
     {
       // Incorrect source image
       addDefaultTexture();
+      m_bakeable = false;  // #SceneCache
       continue;
     }
 
@@ -592,6 +1068,17 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
     m_textures.emplace_back(m_pAlloc->createTexture(image.first, ivInfo, samplerCreateInfo));
 
     NAME_IDX_VK(m_textures[i].image, i);
+
+    // #SceneCache : keep the sampler configuration to rebuild the texture without the glTF
+    SceneCache::Texture ctex{};
+    ctex.imageIndex   = sourceImage;
+    ctex.magFilter    = samplerCreateInfo.magFilter;
+    ctex.minFilter    = samplerCreateInfo.minFilter;
+    ctex.mipmapMode   = samplerCreateInfo.mipmapMode;
+    ctex.addressModeU = samplerCreateInfo.addressModeU;
+    ctex.addressModeV = samplerCreateInfo.addressModeV;
+    ctex.maxLod       = samplerCreateInfo.maxLod;
+    m_bake.textures.emplace_back(ctex);
   }
 
   timer.print();
@@ -601,41 +1088,79 @@ void Scene::createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfMod
 // Creating the descriptor for the scene
 // Vertex, Index and Textures are array of buffers or images
 //
+// #Bindless : the layout is created once and is fixed for the process lifetime. The texture
+// array has a fixed upper bound and is partially bound + update-after-bind, so a scene swap
+// only rewrites descriptors; every pipeline built against the layout stays valid and the
+// renderers survive scene hot-swaps without recompiling.
+//
 void Scene::createDescriptorSet(const nvh::GltfScene& gltf)
 {
-  VkShaderStageFlags flag = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR
-                            | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  auto nb_meshes  = static_cast<uint32_t>(gltf.m_primMeshes.size());
   auto nbTextures = static_cast<uint32_t>(m_textures.size());
+  assert(nbTextures <= s_maxTextures);
 
-  nvvk::DescriptorSetBindings bind;
-  bind.addBinding({SceneBindings::eCamera, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, flag});
-  bind.addBinding({SceneBindings::eMaterials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
-  bind.addBinding({SceneBindings::eTextures, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, nbTextures, flag});
-  bind.addBinding({SceneBindings::eInstData, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
-  bind.addBinding({SceneBindings::eLights, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
-
-  m_descPool = bind.createPool(m_device, 1);
-  CREATE_NAMED_VK(m_descSetLayout, bind.createLayout(m_device));
-  CREATE_NAMED_VK(m_descSet, nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout));
+  if(m_descSetLayout == VK_NULL_HANDLE)
+  {
+    VkShaderStageFlags flag = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR
+                              | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    nvvk::DescriptorSetBindings bind;
+    bind.addBinding({SceneBindings::eCamera, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, flag});
+    bind.addBinding({SceneBindings::eMaterials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
+    bind.addBinding({SceneBindings::eTextures, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, s_maxTextures, flag});
+    bind.addBinding({SceneBindings::eInstData, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
+    bind.addBinding({SceneBindings::eLights, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});
+    bind.addBinding({SceneBindings::eLightAccel, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});  // #LightAccel
+    bind.addBinding({SceneBindings::eViews, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flag});  // #MultiView
+
+    bind.setBindingFlags(SceneBindings::eTextures, VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                                                       | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                                                       | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT);
+
+    m_descPool = bind.createPool(m_device, 1, VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
+    CREATE_NAMED_VK(m_descSetLayout, bind.createLayout(m_device, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT));
+    CREATE_NAMED_VK(m_descSet, nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout));
+  }
 
-  std::array<VkDescriptorBufferInfo, 5> dbi;
-  dbi[eCameraMat] = VkDescriptorBufferInfo{m_buffer[eCameraMat].buffer, 0, VK_WHOLE_SIZE};
-  dbi[eMaterial]  = VkDescriptorBufferInfo{m_buffer[eMaterial].buffer, 0, VK_WHOLE_SIZE};
-  dbi[eInstData]  = VkDescriptorBufferInfo{m_buffer[eInstData].buffer, 0, VK_WHOLE_SIZE};
-  dbi[eLights]    = VkDescriptorBufferInfo{m_buffer[eLights].buffer, 0, VK_WHOLE_SIZE};
+  std::array<VkDescriptorBufferInfo, 7> dbi;
+  dbi[eCameraMat]  = VkDescriptorBufferInfo{m_buffer[eCameraMat].buffer, 0, sizeof(SceneCamera)};  // Dynamic offset selects the slot
+  dbi[eMaterial]   = VkDescriptorBufferInfo{m_buffer[eMaterial].buffer, 0, VK_WHOLE_SIZE};
+  dbi[eInstData]   = VkDescriptorBufferInfo{m_buffer[eInstData].buffer, 0, VK_WHOLE_SIZE};
+  dbi[eLights]     = VkDescriptorBufferInfo{m_buffer[eLights].buffer, 0, VK_WHOLE_SIZE};
+  dbi[eLightAccel] = VkDescriptorBufferInfo{m_buffer[eLightAccel].buffer, 0, VK_WHOLE_SIZE};
+  dbi[eViews]      = VkDescriptorBufferInfo{m_buffer[eViews].buffer, 0, VK_WHOLE_SIZE};
 
   // array of images
   std::vector<VkDescriptorImageInfo> t_info;
   for(auto& texture : m_textures)
     t_info.emplace_back(texture.descriptor);
 
+  auto makeWrite = [&](SceneBindings binding, VkDescriptorType type, const VkDescriptorBufferInfo* info) {
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet          = m_descSet;
+    write.dstBinding      = binding;
+    write.descriptorType  = type;
+    write.descriptorCount = 1;
+    write.pBufferInfo     = info;
+    return write;
+  };
+
   std::vector<VkWriteDescriptorSet> writes;
-  writes.emplace_back(bind.makeWrite(m_descSet, SceneBindings::eCamera, &dbi[eCameraMat]));
-  writes.emplace_back(bind.makeWrite(m_descSet, SceneBindings::eMaterials, &dbi[eMaterial]));
-  writes.emplace_back(bind.makeWrite(m_descSet, SceneBindings::eInstData, &dbi[eInstData]));
-  writes.emplace_back(bind.makeWrite(m_descSet, SceneBindings::eLights, &dbi[eLights]));
-  writes.emplace_back(bind.makeWriteArray(m_descSet, SceneBindings::eTextures, t_info.data()));
+  writes.emplace_back(makeWrite(SceneBindings::eCamera, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, &dbi[eCameraMat]));
+  writes.emplace_back(makeWrite(SceneBindings::eMaterials, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &dbi[eMaterial]));
+  writes.emplace_back(makeWrite(SceneBindings::eInstData, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &dbi[eInstData]));
+  writes.emplace_back(makeWrite(SceneBindings::eLights, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &dbi[eLights]));
+  writes.emplace_back(makeWrite(SceneBindings::eLightAccel, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &dbi[eLightAccel]));
+  writes.emplace_back(makeWrite(SceneBindings::eViews, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, &dbi[eViews]));
+
+  // #Bindless : only the descriptors of the loaded textures are written, the rest of the
+  // array stays unbound (partially-bound binding)
+  VkWriteDescriptorSet texWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+  texWrite.dstSet          = m_descSet;
+  texWrite.dstBinding      = SceneBindings::eTextures;
+  texWrite.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  texWrite.descriptorCount = nbTextures;
+  texWrite.pImageInfo      = t_info.data();
+  writes.emplace_back(texWrite);
 
   // Writing the information
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
@@ -643,43 +1168,70 @@ void Scene::createDescriptorSet(const nvh::GltfScene& gltf)
 
 //--------------------------------------------------------------------------------------------------
 // Updating camera matrix
+// Writes into the frame's slot of the persistently mapped ring; no transfer or barrier in the
+// command buffer, the slot is selected with a dynamic offset when binding the descriptor set.
 //
-void Scene::updateCamera(const VkCommandBuffer& cmdBuf, float aspectRatio)
+uint32_t Scene::updateCamera(float aspectRatio, uint32_t frameSlot)
 {
   const auto& view     = CameraManip.getMatrix();
   const auto  proj     = nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.001f, 100000.0f);
   m_camera.viewInverse = nvmath::invert(view);
   m_camera.projInverse = nvmath::invert(proj);
 
+  // #Denoise : keep last frame's view-projection so the shaders can reproject (motion vectors)
+  m_camera.prevViewProj = m_prevViewProj;
+  m_camera.viewProj     = proj * view;  // #Reproject : for the depth stored with the history
+  m_prevViewProj        = proj * view;
+
   // Focal is the interest point
   nvmath::vec3f eye, center, up;
   CameraManip.getLookat(eye, center, up);
   m_camera.focalDist = nvmath::length(center - eye);
 
-  // UBO on the device
-  VkBuffer deviceUBO = m_buffer[eCameraMat].buffer;
-
-  // Ensure that the modified UBO is not visible to previous frames.
-  VkBufferMemoryBarrier beforeBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  beforeBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  beforeBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  beforeBarrier.buffer        = deviceUBO;
-  beforeBarrier.size          = sizeof(m_camera);
-  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-                       VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 1, &beforeBarrier, 0, nullptr);
-
-
-  // Schedule the host-to-device upload. (hostUBO is copied into the cmd
-  // buffer so it is okay to deallocate when the function returns).
-  vkCmdUpdateBuffer(cmdBuf, deviceUBO, 0, sizeof(SceneCamera), &m_camera);
-
-  // Making sure the updated UBO will be visible.
-  VkBufferMemoryBarrier afterBarrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
-  afterBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  afterBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-  afterBarrier.buffer        = deviceUBO;
-  afterBarrier.size          = sizeof(m_camera);
+  const uint32_t offset = frameSlot * m_camSlotSize;
+  memcpy(m_camMapped + offset, &m_camera, sizeof(SceneCamera));
+  return offset;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #MultiView
+// Updates the per-view cameras of the sensor rig: the main camera yawed around its own position,
+// evenly covering the full circle, each with the projection of one atlas tile. The buffer is a
+// few hundred bytes, an inline vkCmdUpdateBuffer refreshes it in place; the grid itself travels
+// in the camera UBO (see updateCamera).
+//
+void Scene::updateViews(const VkCommandBuffer& cmdBuf, int nbViews, const nvmath::vec2i& grid, float aspectRatio)
+{
+  m_camera.nbViews  = nbViews;
+  m_camera.viewGrid = grid;
+  if(nbViews <= 1)
+    return;
+
+  nvmath::vec3f eye, center, up;
+  CameraManip.getLookat(eye, center, up);
+  const nvmath::mat4f viewInverse = nvmath::invert(CameraManip.getMatrix());
+  const nvmath::mat4f projInverse =
+      nvmath::invert(nvmath::perspectiveVK(CameraManip.getFov(), aspectRatio, 0.001f, 100000.0f));
+
+  std::vector<SceneView> views(nbViews);
+  for(int i = 0; i < nbViews; i++)
+  {
+    const float yaw      = static_cast<float>(i) * 2.f * nvmath::nv_pi / static_cast<float>(nbViews);
+    views[i].viewInverse = nvmath::translation_mat4(eye) * nvmath::rotation_mat4_y(yaw)
+                           * nvmath::translation_mat4(-eye) * viewInverse;
+    views[i].projInverse = projInverse;
+  }
+
+  vkCmdUpdateBuffer(cmdBuf, m_buffer[eViews].buffer, 0, views.size() * sizeof(SceneView), views.data());
+
+  VkBufferMemoryBarrier barrier{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+  barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask       = VK_ACCESS_SHADER_READ_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer              = m_buffer[eViews].buffer;
+  barrier.size                = VK_WHOLE_SIZE;
   vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,
-                       VK_DEPENDENCY_DEVICE_GROUP_BIT, 0, nullptr, 1, &afterBarrier, 0, nullptr);
+                       VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0,
+                       nullptr, 1, &barrier, 0, nullptr);
 }
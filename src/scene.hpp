@@ -32,7 +32,9 @@
 #include "nvvk/debug_util_vk.hpp"
 #include "nvvk/descriptorsets_vk.hpp"
 #include "queue.hpp"
+#include "scene_cache.hpp"
 
+class TextureCache;
 
 class Scene
 {
@@ -43,14 +45,17 @@ public:
     eMaterial,
     eInstData,
     eLights,
+    eLightAccel,  // #LightAccel : alias table to pick lights by estimated power
+    eViews,       // #MultiView : camera matrices of the sensor-rig views
+    eVertexData,  // All vertices of all primitives, packed
+    eIndexData,   // All indices of all primitives, packed
   };
 
-
-  enum EBuffers
+  // Byte location of a primitive in the packed vertex/index buffers
+  struct PrimOffset
   {
-    eVertex,
-    eIndex,
-    eLast_elem
+    VkDeviceSize vertexByteOffset{0};
+    VkDeviceSize indexByteOffset{0};
   };
 
 public:
@@ -63,27 +68,52 @@ public:
   bool loadGltfScene(const std::string& filename, tinygltf::Model& tmodel);
   void createLightBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& gltf);
   void createMaterialBuffer(VkCommandBuffer cmdBuf, const nvh::GltfScene& gltf);
+  // Depth of the per-frame uniform rings, matching the frames in flight of the swapchain
+  static constexpr uint32_t s_ringFrames = 3;
+  // #Bindless : fixed size of the texture descriptor array, the bound scene uses a prefix of it
+  static constexpr uint32_t s_maxTextures = 4096;
+
   void destroy();
-  void updateCamera(const VkCommandBuffer& cmdBuf, float aspectRatio);
+  void deinit();  // destroy() plus the process-lifetime descriptors (#Bindless)
+  // Writes the camera into the ring slot and returns its dynamic offset
+  uint32_t updateCamera(float aspectRatio, uint32_t frameSlot);
+  // #MultiView : refreshes the sensor-rig cameras and the atlas grid; call before updateCamera
+  // so the grid travels in this frame's camera slot
+  void updateViews(const VkCommandBuffer& cmdBuf, int nbViews, const nvmath::vec2i& grid, float aspectRatio);
 
 
   VkDescriptorSetLayout            getDescLayout() { return m_descSetLayout; }
   VkDescriptorSet                  getDescSet() { return m_descSet; }
   nvh::GltfScene&                  getScene() { return m_gltf; }
   nvh::GltfStats&                  getStat() { return m_stats; }
-  const std::vector<nvvk::Buffer>& getBuffers(EBuffers b) { return m_buffers[b]; }
+  const nvvk::Buffer&              getBuffer(EBuffer b) { return m_buffer[b]; }
+  const std::vector<InstanceData>& getInstData() const { return m_instData; }
   const std::string&               getSceneName() const { return m_sceneName; }
   SceneCamera&                     getCamera() { return m_camera; }
 
 private:
   void createTextureImages(VkCommandBuffer cmdBuf, tinygltf::Model& gltfModel);
+  bool createCachedTextureImage(VkCommandBuffer cmdBuf, tinygltf::Image& gltfimage, size_t idx);
+  void addCacheImage(VkCommandBuffer cmdBuf, const TextureCache& cache, size_t idx);
   void createDescriptorSet(const nvh::GltfScene& gltf);
+  // #SceneCache : fast path from the binary sidecar and its bake after a full glTF load
+  bool loadCached(const std::string& filename);
+  void bakeSceneCache(const std::string& filename, const nvh::GltfScene& gltf);
+  void trimStagingArena();  // #StagingArena
 
   nvh::GltfScene m_gltf;
   nvh::GltfStats m_stats;
 
+  // #SceneCache : collected along the glTF load for the sidecar bake
+  SceneCache::BakeData m_bake;
+  bool                 m_bakeable{true};
+
   std::string m_sceneName;
+  std::string m_sceneDir;  // Directory of the loaded scene, for the texture sidecar caches
   SceneCamera m_camera{};
+  uint32_t    m_camSlotSize{0};       // Aligned size of one camera slot in the ring
+  uint8_t*    m_camMapped{nullptr};   // Persistent mapping of the camera ring
+  nvmath::mat4f m_prevViewProj{1};    // #Denoise : view-projection of the last updateCamera()
 
   // Setup
   nvvk::ResourceAllocator* m_pAlloc;  // Allocator for buffer, images, acceleration structures
@@ -92,8 +122,9 @@ private:
   nvvk::Queue              m_queue;
 
   // Resources
-  std::array<nvvk::Buffer, 5>                            m_buffer;           // For single buffer
-  std::array<std::vector<nvvk::Buffer>, 2>               m_buffers;          // For array of buffers (vertex/index)
+  std::array<nvvk::Buffer, 8>                            m_buffer;           // For single buffer
+  std::vector<PrimOffset>                                m_primOffsets;      // Per-primitive offsets in the packed buffers
+  std::vector<InstanceData>                              m_instData;         // Per-primitive addresses and material
   std::vector<nvvk::Texture>                             m_textures;         // vector of all textures of the scene
   std::vector<std::pair<nvvk::Image, VkImageCreateInfo>> m_images;           // vector of all images of the scene
   std::vector<size_t>                                    m_defaultTextures;  // for cleanup
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "scene_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "nvh/nvprint.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct CacheSection
+{
+  uint64_t offset{0};
+  uint64_t count{0};
+};
+
+// File layout: header, then the sections back to back at the offsets recorded here. The sizeof
+// fields guard the structs that are stored raw: when host_device.h evolves, the cache is simply
+// rejected and rebuilt from the glTF.
+struct CacheHeader
+{
+  uint32_t magic{0x4353564E};  // 'NVSC'
+  uint32_t version{1};
+  uint32_t vertexSize{sizeof(VertexAttributes)};
+  uint32_t materialSize{sizeof(GltfShadeMaterial)};
+  uint32_t lightSize{sizeof(Light)};
+  uint32_t nbLights{0};
+
+  CacheSection primMeshes;
+  CacheSection nodes;
+  CacheSection materials;
+  CacheSection lights;
+  CacheSection images;
+  CacheSection textures;
+  CacheSection cameras;
+  CacheSection strings;
+  CacheSection vertices;
+  CacheSection indices;
+
+  SceneCache::Stats      stats{};
+  SceneCache::Dimensions dimensions{};
+};
+
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Maps the cache file and sets up the typed views into the sections
+//
+bool SceneCache::open(const std::string& cacheFile, const std::string& sourceFile)
+{
+  close();
+
+  // A glTF newer than its cache invalidates the cache
+  std::error_code ec1, ec2;
+  auto            sourceTime = fs::last_write_time(sourceFile, ec1);
+  auto            cacheTime  = fs::last_write_time(cacheFile, ec2);
+  if(ec1 || ec2 || cacheTime < sourceTime)
+    return false;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file, &fileSize);
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  m_mapped     = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  m_mappedSize = static_cast<size_t>(fileSize.QuadPart);
+  m_file       = file;
+  m_mapping    = mapping;
+#else
+  int fd = ::open(cacheFile.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat st;
+  fstat(fd, &st);
+  m_mapped     = static_cast<const uint8_t*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  m_mappedSize = static_cast<size_t>(st.st_size);
+  m_fd         = fd;
+  if(m_mapped == MAP_FAILED)
+  {
+    m_mapped = nullptr;
+    close();
+    return false;
+  }
+#endif
+
+  if(m_mapped == nullptr || m_mappedSize < sizeof(CacheHeader))
+  {
+    close();
+    return false;
+  }
+
+  CacheHeader header;
+  memcpy(&header, m_mapped, sizeof(header));
+  if(header.magic != CacheHeader().magic || header.version != CacheHeader().version
+     || header.vertexSize != sizeof(VertexAttributes) || header.materialSize != sizeof(GltfShadeMaterial)
+     || header.lightSize != sizeof(Light))
+  {
+    close();
+    return false;
+  }
+
+  auto sectionValid = [&](const CacheSection& s, size_t elemSize) {
+    return s.offset + s.count * elemSize <= m_mappedSize;
+  };
+  if(!sectionValid(header.primMeshes, sizeof(PrimMesh)) || !sectionValid(header.nodes, sizeof(Node))
+     || !sectionValid(header.materials, sizeof(GltfShadeMaterial)) || !sectionValid(header.lights, sizeof(Light))
+     || !sectionValid(header.images, sizeof(Image)) || !sectionValid(header.textures, sizeof(Texture))
+     || !sectionValid(header.cameras, sizeof(Camera)) || !sectionValid(header.strings, 1)
+     || !sectionValid(header.vertices, sizeof(VertexAttributes)) || !sectionValid(header.indices, sizeof(uint32_t)))
+  {
+    close();  // Truncated file
+    return false;
+  }
+
+  m_primMeshes    = reinterpret_cast<const PrimMesh*>(m_mapped + header.primMeshes.offset);
+  m_primMeshCount = header.primMeshes.count;
+  m_nodes         = reinterpret_cast<const Node*>(m_mapped + header.nodes.offset);
+  m_nodeCount     = header.nodes.count;
+  m_materials     = reinterpret_cast<const GltfShadeMaterial*>(m_mapped + header.materials.offset);
+  m_materialCount = header.materials.count;
+  m_lights        = reinterpret_cast<const Light*>(m_mapped + header.lights.offset);
+  m_lightCount    = header.lights.count;
+  m_images        = reinterpret_cast<const Image*>(m_mapped + header.images.offset);
+  m_imageCount    = header.images.count;
+  m_textures      = reinterpret_cast<const Texture*>(m_mapped + header.textures.offset);
+  m_textureCount  = header.textures.count;
+  m_cameras       = reinterpret_cast<const Camera*>(m_mapped + header.cameras.offset);
+  m_cameraCount   = header.cameras.count;
+  m_strings       = reinterpret_cast<const char*>(m_mapped + header.strings.offset);
+  m_vertices      = reinterpret_cast<const VertexAttributes*>(m_mapped + header.vertices.offset);
+  m_vertexCount   = header.vertices.count;
+  m_indices       = reinterpret_cast<const uint32_t*>(m_mapped + header.indices.offset);
+  m_indexCount    = header.indices.count;
+  m_nbLights      = header.nbLights;
+  m_stats         = header.stats;
+  m_dimensions    = header.dimensions;
+  return true;
+}
+
+void SceneCache::close()
+{
+#ifdef _WIN32
+  if(m_mapped != nullptr)
+    UnmapViewOfFile(m_mapped);
+  if(m_mapping != nullptr)
+    CloseHandle(m_mapping);
+  if(m_file != nullptr)
+    CloseHandle(m_file);
+  m_file    = nullptr;
+  m_mapping = nullptr;
+#else
+  if(m_mapped != nullptr)
+    munmap(const_cast<uint8_t*>(m_mapped), m_mappedSize);
+  if(m_fd >= 0)
+    ::close(m_fd);
+  m_fd = -1;
+#endif
+  m_mapped     = nullptr;
+  m_mappedSize = 0;
+  m_primMeshes = nullptr;
+  m_nodes      = nullptr;
+  m_materials  = nullptr;
+  m_lights     = nullptr;
+  m_images     = nullptr;
+  m_textures   = nullptr;
+  m_cameras    = nullptr;
+  m_vertices   = nullptr;
+  m_indices    = nullptr;
+  m_strings    = nullptr;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Lays out the sections back to back and writes the cache file
+//
+bool SceneCache::bake(const std::string& cacheFile, const BakeData& data)
+{
+  CacheHeader header;
+  header.nbLights   = data.nbLights;
+  header.stats      = data.stats;
+  header.dimensions = data.dimensions;
+
+  uint64_t offset = sizeof(CacheHeader);
+  auto layoutSection = [&offset](CacheSection& s, uint64_t count, size_t elemSize) {
+    s.offset = offset;
+    s.count  = count;
+    offset += count * elemSize;
+  };
+  layoutSection(header.primMeshes, data.primMeshes.size(), sizeof(PrimMesh));
+  layoutSection(header.nodes, data.nodes.size(), sizeof(Node));
+  layoutSection(header.materials, data.materials.size(), sizeof(GltfShadeMaterial));
+  layoutSection(header.lights, data.lights.size(), sizeof(Light));
+  layoutSection(header.images, data.images.size(), sizeof(Image));
+  layoutSection(header.textures, data.textures.size(), sizeof(Texture));
+  layoutSection(header.cameras, data.cameras.size(), sizeof(Camera));
+  layoutSection(header.strings, data.stringBlob.size(), 1);
+  layoutSection(header.vertices, data.vertices.size(), sizeof(VertexAttributes));
+  layoutSection(header.indices, data.indices.size(), sizeof(uint32_t));
+
+  FILE* file = fopen(cacheFile.c_str(), "wb");
+  if(file == nullptr)
+  {
+    LOGW("SceneCache: cannot write %s\n", cacheFile.c_str());
+    return false;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(data.primMeshes.data(), sizeof(PrimMesh), data.primMeshes.size(), file);
+  fwrite(data.nodes.data(), sizeof(Node), data.nodes.size(), file);
+  fwrite(data.materials.data(), sizeof(GltfShadeMaterial), data.materials.size(), file);
+  fwrite(data.lights.data(), sizeof(Light), data.lights.size(), file);
+  fwrite(data.images.data(), sizeof(Image), data.images.size(), file);
+  fwrite(data.textures.data(), sizeof(Texture), data.textures.size(), file);
+  fwrite(data.cameras.data(), sizeof(Camera), data.cameras.size(), file);
+  fwrite(data.stringBlob.data(), 1, data.stringBlob.size(), file);
+  fwrite(data.vertices.data(), sizeof(VertexAttributes), data.vertices.size(), file);
+  fwrite(data.indices.data(), sizeof(uint32_t), data.indices.size(), file);
+  fclose(file);
+  return true;
+}
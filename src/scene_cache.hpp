@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//--------------------------------------------------------------------------------------------------
+// #SceneCache
+// Sidecar cache of the post-processed scene, baked next to the glTF on first load. It holds the
+// packed and compressed VertexAttributes / indices and everything else Scene rebuilds from the
+// glTF (materials, lights, nodes, texture references), behind a header of section offsets.
+// Subsequent loads memory-map the file and feed the staging uploads straight from it, skipping
+// the tinygltf parse and the attribute conversion entirely (see Scene::loadCached).
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "nvmath/nvmath.h"
+#include "shaders/host_device.h"
+
+class SceneCache
+{
+public:
+  // Flat mirrors of the nvh scene pieces still consumed after loading (TLAS flags, instance
+  // transforms, GUI statistics); only what is read downstream is kept
+  struct PrimMesh
+  {
+    uint32_t      firstIndex{0};
+    uint32_t      indexCount{0};
+    uint32_t      vertexOffset{0};
+    uint32_t      vertexCount{0};
+    int32_t       materialIndex{0};
+    nvmath::vec3f posMin{0, 0, 0};
+    nvmath::vec3f posMax{0, 0, 0};
+    uint64_t      nameOffset{0};        // Into the string section
+    uint64_t      vertexByteOffset{0};  // Scene::PrimOffset, shared vertex ranges included
+    uint64_t      indexByteOffset{0};
+  };
+
+  struct Node
+  {
+    nvmath::mat4f worldMatrix;
+    int32_t       primMesh{0};
+    int32_t       pad[3]{0, 0, 0};
+  };
+
+  struct Image
+  {
+    uint64_t uriOffset{0};  // Into the string section; the pixels live in the #TexCache sidecar
+  };
+
+  struct Texture
+  {
+    int32_t  imageIndex{0};
+    uint32_t magFilter{0};  // VkFilter and friends, as built by gltfSamplerToVulkan
+    uint32_t minFilter{0};
+    uint32_t mipmapMode{0};
+    uint32_t addressModeU{0};
+    uint32_t addressModeV{0};
+    float    maxLod{0};
+  };
+
+  struct Camera
+  {
+    nvmath::vec3f eye{0, 0, 0};
+    nvmath::vec3f center{0, 0, 0};
+    nvmath::vec3f up{0, 1, 0};
+    float         yfov{60.f};
+  };
+
+  struct Stats  // What guiStatistics() displays
+  {
+    uint32_t nbCameras{0};
+    uint32_t nbImages{0};
+    uint32_t nbTextures{0};
+    uint32_t nbMaterials{0};
+    uint32_t nbSamplers{0};
+    uint32_t nbNodes{0};
+    uint32_t nbMeshes{0};
+    uint32_t nbLights{0};
+    uint64_t imageMem{0};
+    uint64_t nbTriangles{0};
+    uint64_t nbUniqueTriangles{0};
+  };
+
+  struct Dimensions
+  {
+    nvmath::vec3f min{0, 0, 0};
+    nvmath::vec3f max{0, 0, 0};
+    nvmath::vec3f size{0, 0, 0};
+    nvmath::vec3f center{0, 0, 0};
+    float         radius{0};
+  };
+
+  // Everything Scene::load collects for the bake; the string section is built with addString
+  struct BakeData
+  {
+    std::vector<PrimMesh>          primMeshes;
+    std::vector<Node>              nodes;
+    std::vector<GltfShadeMaterial> materials;
+    std::vector<Light>             lights;  // As uploaded, the dummy entry included
+    uint32_t                       nbLights{0};  // Real light count, for SceneCamera::nbLights
+    std::vector<Image>             images;
+    std::vector<Texture>           textures;
+    std::vector<Camera>            cameras;
+    Stats                          stats{};
+    Dimensions                     dimensions{};
+    std::vector<VertexAttributes>  vertices;  // Packed and compressed, ready for upload
+    std::vector<uint32_t>          indices;
+    std::string                    stringBlob;
+
+    uint64_t addString(const std::string& s)
+    {
+      uint64_t offset = stringBlob.size();
+      stringBlob += s;
+      stringBlob.push_back('\0');
+      return offset;
+    }
+  };
+
+  ~SceneCache() { close(); }
+
+  // Opens and maps the cache; false when missing, incompatible or older than the source file
+  bool open(const std::string& cacheFile, const std::string& sourceFile);
+  void close();
+
+  // Writes the cache file; false when the file cannot be written
+  static bool bake(const std::string& cacheFile, const BakeData& data);
+
+  // Cache file next to the scene
+  static std::string cachePath(const std::string& sceneFile) { return sceneFile + ".nvscn"; }
+
+  const PrimMesh*          primMeshes() const { return m_primMeshes; }
+  uint64_t                 primMeshCount() const { return m_primMeshCount; }
+  const Node*              nodes() const { return m_nodes; }
+  uint64_t                 nodeCount() const { return m_nodeCount; }
+  const GltfShadeMaterial* materials() const { return m_materials; }
+  uint64_t                 materialCount() const { return m_materialCount; }
+  const Light*             lights() const { return m_lights; }
+  uint64_t                 lightCount() const { return m_lightCount; }
+  uint32_t                 nbLights() const { return m_nbLights; }
+  const Image*             images() const { return m_images; }
+  uint64_t                 imageCount() const { return m_imageCount; }
+  const Texture*           textures() const { return m_textures; }
+  uint64_t                 textureCount() const { return m_textureCount; }
+  const Camera*            cameras() const { return m_cameras; }
+  uint64_t                 cameraCount() const { return m_cameraCount; }
+  const Stats&             stats() const { return m_stats; }
+  const Dimensions&        dimensions() const { return m_dimensions; }
+  const VertexAttributes*  vertices() const { return m_vertices; }
+  uint64_t                 vertexCount() const { return m_vertexCount; }
+  const uint32_t*          indices() const { return m_indices; }
+  uint64_t                 indexCount() const { return m_indexCount; }
+  const char*              string(uint64_t offset) const { return m_strings + offset; }
+
+private:
+  const PrimMesh*          m_primMeshes{nullptr};
+  const Node*              m_nodes{nullptr};
+  const GltfShadeMaterial* m_materials{nullptr};
+  const Light*             m_lights{nullptr};
+  const Image*             m_images{nullptr};
+  const Texture*           m_textures{nullptr};
+  const Camera*            m_cameras{nullptr};
+  const VertexAttributes*  m_vertices{nullptr};
+  const uint32_t*          m_indices{nullptr};
+  const char*              m_strings{nullptr};
+  uint64_t                 m_primMeshCount{0};
+  uint64_t                 m_nodeCount{0};
+  uint64_t                 m_materialCount{0};
+  uint64_t                 m_lightCount{0};
+  uint64_t                 m_imageCount{0};
+  uint64_t                 m_textureCount{0};
+  uint64_t                 m_cameraCount{0};
+  uint64_t                 m_vertexCount{0};
+  uint64_t                 m_indexCount{0};
+  uint32_t                 m_nbLights{0};
+  Stats                    m_stats{};
+  Dimensions               m_dimensions{};
+
+  // Mapped file
+  const uint8_t* m_mapped{nullptr};
+  size_t         m_mappedSize{0};
+#ifdef _WIN32
+  void* m_file{nullptr};
+  void* m_mapping{nullptr};
+#else
+  int m_fd{-1};
+#endif
+};
@@ -25,13 +25,21 @@
 
 #include "simulator.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <future>
+
 #include "denoiser.hpp"
 #include "fileformats/tiny_gltf_freeimage.h"
 #include "gui.hpp"
 #include "nvml_monitor.hpp"
 #include "rayquery.hpp"
 #include "rtx_pipeline.hpp"
+#include "wavefront.hpp"
+#include "nvh/alignment.hpp"
+#include "nvvk/commands_vk.hpp"
 #include "shaders/host_device.h"
+#include "stb_image_write.h"
 #include "tools.hpp"
 #include "tracy/Tracy.hpp"
 
@@ -39,6 +47,10 @@
 NvmlMonitor g_nvml(100, 100);
 #endif
 
+// #StagingArena : staging block size; large enough that even the big scenarios upload through
+// a handful of persistent blocks (the default 64 MB creates and destroys dozens of them)
+static constexpr VkDeviceSize s_stagingBlockSize = 256ull * 1024ull * 1024ull;
+
 //--------------------------------------------------------------------------------------------------
 // Keep the handle on the device
 // Initialize the tool to do all our allocations: buffers, images
@@ -49,8 +61,13 @@ void Simulator::setup(const VkInstance& instance, const VkDevice& device, const
 
   m_gui = std::make_shared<SimGUI>(this);  // GUI of this class
 
-  // Memory allocator for buffers and images
-  m_alloc.init(instance, device, physicalDevice);
+  // Memory allocator for buffers and images. DMA suballocates the device memory from large
+  // blocks, so scene loads do not create one VkDeviceMemory per resource.
+  // #StagingArena : large pinned staging blocks, kept alive across uploads instead of being
+  // freed by finalizeAndReleaseStaging. Scenes are hot-swapped dozens of times per session
+  // (onFileDrop) and every load reuses the same staging memory, no allocation or map churn.
+  m_alloc.init(instance, device, physicalDevice, s_stagingBlockSize);
+  m_alloc.getStaging()->setFreeUnusedOnRelease(false);
 
   m_debug.setup(m_device);
 
@@ -64,13 +81,24 @@ void Simulator::setup(const VkInstance& instance, const VkDevice& device, const
 
   // Transfer queues can be use for the creation of the following assets
   m_offscreen.setup(m_device, physicalDevice, queues[eTransfer].familyIndex, &m_alloc);
-  m_skydome.setup(device, physicalDevice, queues[eTransfer].familyIndex, &m_alloc);
+
+  // #HdrBuild : the alias-map builder dispatches compute kernels, so the skydome needs the
+  // compute-capable loader queue instead of the transfer one
+  m_skydome.setup(device, physicalDevice, queues[eGCT1], &m_alloc);
+
+  // Pipeline cache, pre-loaded from the previous run
+  m_pipelineCache.init(m_device, NVPSystem::exePath() + PROJECT_NAME + std::string("_pipelinecache.bin"));
+
+  // #AsyncCompute : the same compute queue runs the RayQuery dispatch when the mode is on
+  createAsyncCompute(queues[eCompute]);
 
   // Create and setup all renderers
   m_pRender[eRtxPipeline] = new RtxPipeline;
   m_pRender[eRayQuery]    = new RayQuery;
+  m_pRender[eWavefront]   = new Wavefront;
   for (auto r : m_pRender) {
     r->setup(m_device, physicalDevice, queues[eTransfer].familyIndex, &m_alloc);
+    r->setPipelineCache(m_pipelineCache.cache);
   }
 }
 
@@ -80,7 +108,7 @@ void Simulator::setup(const VkInstance& instance, const VkDevice& device, const
 //
 void Simulator::loadScene(const std::string& filename) {
   m_scene.load(filename);
-  m_accelStruct.create(m_scene.getScene(), m_scene.getBuffers(Scene::eVertex), m_scene.getBuffers(Scene::eIndex));
+  m_accelStruct.create(m_scene.getScene(), m_scene.getInstData());
 
   // The picker is the helper to return information from a ray hit under the mouse cursor
   m_picker.setTlas(m_accelStruct.getTlas());
@@ -123,14 +151,27 @@ void Simulator::loadAssets(const char* filename) {
       // Loading scene and creating acceleration structure
       loadScene(sfile);
 
-      // Loading the scene might have loaded new textures, which is changing the number of elements
-      // in the DescriptorSetLayout. Therefore, the PipelineLayout will be out-of-date and need
-      // to be re-created. If they are re-created, the pipeline also need to be re-created.
-      for (auto& r : m_pRender) r->destroy();
-
-      m_pRender[m_rndMethod]->create(
-        m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout},
-        &m_scene);
+      // #Bindless : the scene descriptor layout is fixed for the process lifetime (partially
+      // bound texture array), so the load only rewrote descriptors and every pipeline built
+      // against it stays valid. Renderers are built once - concurrently, on the first load -
+      // and survive all later scene hot-swaps.
+      std::vector<std::future<void>> createJobs;
+      for (size_t i = 0; i < m_pRender.size(); i++) {
+        if (m_renderValid[i]) {
+          // The pipelines survive, but per-scene snapshots (the wavefront instance
+          // transforms) belong to the previous scene
+          m_pRender[i]->onSceneChange(&m_scene);
+          continue;
+        }
+        auto r = m_pRender[i];
+        createJobs.emplace_back(std::async(std::launch::async, [&, r]() {
+          r->create(m_size,
+                    {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout},
+                    &m_scene);
+        }));
+      }
+      for (auto& j : createJobs) j.get();
+      m_renderValid.fill(true);
     }
 
     if (extension == ".hdr")  //|| extension == ".exr")
@@ -153,11 +194,26 @@ void Simulator::updateUniformBuffer(const VkCommandBuffer& cmdBuf) {
   if (m_busy)
     return;
 
-  LABEL_SCOPE_VK(cmdBuf);
+  // Plain memcpy into the frame's ring slot; no inline transfer or barrier in the command buffer,
+  // the slots are selected with dynamic offsets when binding the descriptor sets.
+  m_frameSlot             = (m_frameSlot + 1) % Scene::s_ringFrames;
   const float aspectRatio = m_renderRegion.extent.width / static_cast<float>(m_renderRegion.extent.height);
 
-  m_scene.updateCamera(cmdBuf, aspectRatio);
-  vkCmdUpdateBuffer(cmdBuf, m_sunAndSkyBuffer.buffer, 0, sizeof(SunAndSky), &m_sunAndSky);
+  // #MultiView : the sensor-rig matrices and the atlas grid, written before the camera UBO so
+  // the grid rides along in this frame's slot; each view gets the projection of its own tile
+  const int     nbViews = m_settings.nbViews;
+  nvmath::vec2i grid{1, 1};
+  float         viewAspect = aspectRatio;
+  if (nbViews > 1) {
+    grid.x     = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(nbViews))));
+    grid.y     = (nbViews + grid.x - 1) / grid.x;
+    viewAspect = aspectRatio * static_cast<float>(grid.y) / static_cast<float>(grid.x);
+  }
+  m_scene.updateViews(cmdBuf, nbViews, grid, viewAspect);
+
+  m_dynOffsets[0] = m_scene.updateCamera(aspectRatio, m_frameSlot);
+  m_dynOffsets[1] = m_frameSlot * m_sunSkySlotSize;
+  memcpy(m_sunSkyMapped + m_dynOffsets[1], &m_sunAndSky, sizeof(SunAndSky));
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -167,12 +223,19 @@ void Simulator::updateFrame() {
   static nvmath::mat4f refCamMatrix;
   static float         fov = 0;
 
+  if (m_settings.animate)  // #Refit : the geometry moves, every frame starts a new accumulation
+    resetFrame();
+
   auto& m = CameraManip.getMatrix();
   auto  f = CameraManip.getFov();
   if (memcmp(&refCamMatrix.a00, &m.a00, sizeof(nvmath::mat4f)) != 0 || f != fov) {
+    // #Reproject : a camera move keeps the history valid, the shaders warp it; any other
+    // reset (resetFrame below clears the flag) discards it
+    bool keepHistory = m_reprojectHistory;
     resetFrame();
-    refCamMatrix = m;
-    fov          = f;
+    m_reprojectHistory = keepHistory && m_settings.reproject;
+    refCamMatrix       = m;
+    fov                = f;
   }
 
   if (m_rtxState.frame < m_maxFrames)
@@ -183,7 +246,38 @@ void Simulator::updateFrame() {
 // Reset frame is re-starting the rendering
 //
 void Simulator::resetFrame() {
-  m_rtxState.frame = -1;
+  m_rtxState.frame   = -1;
+  m_reprojectHistory = false;  // #Reproject : the history no longer matches what is rendered
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Refit : turntable of the scene around its center, the only animation of the sample. The new
+// node transforms go into a TLAS refit recorded ahead of the trace in the same command buffer.
+//
+void Simulator::updateAnimation(const VkCommandBuffer& cmdBuf) {
+  if (!m_settings.animate)
+    return;
+  auto& gltf = m_scene.getScene();
+  if (gltf.m_nodes.empty())
+    return;
+
+  static MilliTimer timer;  // Wall clock, so the turn speed is frame-rate independent
+  const float       angle  = static_cast<float>(timer.elapsed()) * (2.f * nvmath::nv_pi / 12000.f);  // One turn / 12 s
+  const nvmath::vec3f center = (gltf.m_dimensions.min + gltf.m_dimensions.max) * 0.5f;
+  const nvmath::mat4f turn =
+    nvmath::translation_mat4(center) * nvmath::rotation_mat4_y(angle) * nvmath::translation_mat4(-center);
+
+  std::vector<nvmath::mat4f> matrices;
+  matrices.reserve(gltf.m_nodes.size());
+  for (auto& node : gltf.m_nodes)
+    matrices.push_back(turn * node.worldMatrix);
+  m_accelStruct.updateTopLevelAS(cmdBuf, matrices);
+
+  // The wavefront shade kernel reconstructs normals and world positions from its own copy of
+  // the transforms, keep it in step with the TLAS
+  if (m_rndMethod == eWavefront)
+    if (auto wf = dynamic_cast<Wavefront*>(m_pRender[eWavefront]))
+      wf->updateInstanceTransforms(cmdBuf, matrices);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -194,9 +288,11 @@ void Simulator::createDescriptorSetLayout() {
                              VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT |
                              VK_SHADER_STAGE_FRAGMENT_BIT;
 
-  m_bind.addBinding({EnvBindings::eSunSky, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_MISS_BIT_KHR | flags});
+  m_bind.addBinding(
+    {EnvBindings::eSunSky, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_MISS_BIT_KHR | flags});
   m_bind.addBinding({EnvBindings::eHdr, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, flags});  // HDR image
   m_bind.addBinding({EnvBindings::eImpSamples, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});   // importance sampling
+  m_bind.addBinding({EnvBindings::eRayStats, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, flags});     // #Stats : ray counters
 
   m_descPool = m_bind.createPool(m_device, 1);
   CREATE_NAMED_VK(m_descSetLayout, m_bind.createLayout(m_device));
@@ -204,11 +300,13 @@ void Simulator::createDescriptorSetLayout() {
 
   // Using the environment
   std::vector<VkWriteDescriptorSet> writes;
-  VkDescriptorBufferInfo            sunskyDesc{m_sunAndSkyBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            sunskyDesc{m_sunAndSkyBuffer.buffer, 0, sizeof(SunAndSky)};  // Dynamic offset selects the slot
   VkDescriptorBufferInfo            accelImpSmpl{m_skydome.m_accelImpSmpl.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo            rayStatsDesc{m_rayStatsBuffer.buffer, 0, VK_WHOLE_SIZE};
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eSunSky, &sunskyDesc));
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eHdr, &m_skydome.m_texHdr.descriptor));
   writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eImpSamples, &accelImpSmpl));
+  writes.emplace_back(m_bind.makeWrite(m_descSet, EnvBindings::eRayStats, &rayStatsDesc));
 
   vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
 }
@@ -230,18 +328,174 @@ void Simulator::updateHdrDescriptors() {
 // - Buffer is host visible and will be set each frame
 //
 void Simulator::createUniformBuffer() {
+  // Persistently mapped ring with one slot per frame in flight, bound with a dynamic offset
+  VkPhysicalDeviceProperties props;
+  vkGetPhysicalDeviceProperties(m_physicalDevice, &props);
+  m_sunSkySlotSize =
+    static_cast<uint32_t>(nvh::align_up(sizeof(SunAndSky), props.limits.minUniformBufferOffsetAlignment));
+
   m_sunAndSkyBuffer =
-    m_alloc.createBuffer(sizeof(SunAndSky), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    m_alloc.createBuffer(m_sunSkySlotSize * Scene::s_ringFrames, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
   NAME_VK(m_sunAndSkyBuffer.buffer);
+  m_sunSkyMapped = static_cast<uint8_t*>(m_alloc.map(m_sunAndSkyBuffer));
+
+  // #Stats : atomic ray counters, host visible for the unfenced readback in fetchRayStats
+  m_rayStatsBuffer = m_alloc.createBuffer(sizeof(RayStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  NAME_VK(m_rayStatsBuffer.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Stats
+// Reads the ray counters of an already finished frame (the buffer is host visible and never
+// fenced, the values are a few frames old), then resets them for the frame being recorded.
+//
+void Simulator::fetchRayStats(const VkCommandBuffer& cmdBuf) {
+  m_rayStats = *static_cast<RayStats*>(m_alloc.map(m_rayStatsBuffer));
+  m_alloc.unmap(m_rayStatsBuffer);
+
+  vkCmdFillBuffer(cmdBuf, m_rayStatsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+  VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, 0, 1, &mb,
+                       0, nullptr, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #AsyncCompute
+// Creates the command buffers and timeline semaphores used to run the RayQuery dispatch on the
+// dedicated compute queue. Per frame N: the dispatch waits for the display copy of N-1 to be done
+// with the result image, a small graphics submission then copies the result to the display image,
+// and the frame command buffer (tonemap, GUI) is ordered after the copy by a pipeline barrier.
+// The path trace of frame N thus overlaps the post/GUI/present of frame N-1.
+//
+void Simulator::createAsyncCompute(const nvvk::Queue& queue) {
+  m_async.queue = queue;
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = queue.familyIndex;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_async.computePool);
+  poolInfo.queueFamilyIndex = m_graphicsQueueIndex;
+  vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_async.graphicsPool);
+
+  VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = AsyncCompute::s_ringSize;
+  allocInfo.commandPool        = m_async.computePool;
+  vkAllocateCommandBuffers(m_device, &allocInfo, m_async.computeCmd.data());
+  allocInfo.commandPool = m_async.graphicsPool;
+  vkAllocateCommandBuffers(m_device, &allocInfo, m_async.copyCmd.data());
+
+  // Timeline semaphores (core in Vulkan 1.2), carrying the async frame counter
+  VkSemaphoreTypeCreateInfo timelineInfo{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+  timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  timelineInfo.initialValue  = 0;
+  VkSemaphoreCreateInfo semInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+  semInfo.pNext = &timelineInfo;
+  vkCreateSemaphore(m_device, &semInfo, nullptr, &m_async.semCompute);
+  vkCreateSemaphore(m_device, &semInfo, nullptr, &m_async.semDisplay);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #AsyncCompute
+// Starts recording the compute command buffer of this frame, reusing the oldest ring slot once
+// its submissions have retired (the display copy is the last consumer of a slot's frame).
+//
+VkCommandBuffer Simulator::beginAsyncCompute() {
+  if (m_async.frame >= AsyncCompute::s_ringSize) {
+    const uint64_t      retired = m_async.frame - AsyncCompute::s_ringSize + 1;
+    VkSemaphoreWaitInfo waitInfo{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores    = &m_async.semDisplay;
+    waitInfo.pValues        = &retired;
+    vkWaitSemaphores(m_device, &waitInfo, ~0ULL);
+  }
+
+  VkCommandBuffer          cmdBuf = m_async.computeCmd[m_async.frame % AsyncCompute::s_ringSize];
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmdBuf, &beginInfo);
+  return cmdBuf;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #AsyncCompute
+// Submits the recorded dispatch to the compute queue, then a small graphics submission copying
+// the result to the display image (and rebuilding its mip pyramid for the auto exposure). The
+// frame command buffer only samples the display copy, so the next dispatch can already overwrite
+// the result image while the graphics queue is still tonemapping, drawing the GUI and presenting.
+//
+void Simulator::submitAsyncCompute() {
+  const uint64_t frame = ++m_async.frame;
+  const uint32_t slot  = static_cast<uint32_t>((frame - 1) % AsyncCompute::s_ringSize);
+
+  VkCommandBuffer computeCmd = m_async.computeCmd[slot];
+  vkEndCommandBuffer(computeCmd);
+
+  // Dispatch of frame N: waits until the display copy of N-1 is done reading the result image
+  uint64_t                      waitValue   = frame - 1;
+  uint64_t                      signalValue = frame;
+  VkTimelineSemaphoreSubmitInfo timeline{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+  timeline.waitSemaphoreValueCount   = 1;
+  timeline.pWaitSemaphoreValues      = &waitValue;
+  timeline.signalSemaphoreValueCount = 1;
+  timeline.pSignalSemaphoreValues    = &signalValue;
+
+  const VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  VkSubmitInfo               submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.pNext                = &timeline;
+  submitInfo.waitSemaphoreCount   = 1;
+  submitInfo.pWaitSemaphores      = &m_async.semDisplay;
+  submitInfo.pWaitDstStageMask    = &computeWaitStage;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores    = &m_async.semCompute;
+  submitInfo.commandBufferCount   = 1;
+  submitInfo.pCommandBuffers      = &computeCmd;
+  vkQueueSubmit(m_async.queue.queue, 1, &submitInfo, VK_NULL_HANDLE);
+
+  // Display copy of frame N: waits for the dispatch; the trailing barrier in copyToDisplay
+  // orders the tonemap of the frame command buffer, submitted after this one on the same queue
+  VkCommandBuffer          copyCmd = m_async.copyCmd[slot];
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(copyCmd, &beginInfo);
+  m_offscreen.copyToDisplay(copyCmd);
+  if (m_offscreen.m_tonemapper.autoExposure)
+    m_offscreen.genMipmap(copyCmd);
+  vkEndCommandBuffer(copyCmd);
+
+  const VkPipelineStageFlags copyWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  submitInfo.pWaitSemaphores               = &m_async.semCompute;
+  submitInfo.pWaitDstStageMask             = &copyWaitStage;
+  submitInfo.pSignalSemaphores             = &m_async.semDisplay;
+  submitInfo.pCommandBuffers               = &copyCmd;
+  vkQueueSubmit(m_queue, 1, &submitInfo, VK_NULL_HANDLE);
 }
 
 //--------------------------------------------------------------------------------------------------
 // Destroying all allocations
 //
 void Simulator::destroyResources() {
+  // #Stream : joins the consumer thread before its buffers go away
+  m_frameStream.deinit();
+
   // Resources
+  if (m_sunSkyMapped != nullptr) {
+    m_alloc.unmap(m_sunAndSkyBuffer);
+    m_sunSkyMapped = nullptr;
+  }
   m_alloc.destroy(m_sunAndSkyBuffer);
+  m_alloc.destroy(m_rayStatsBuffer);
+
+  // #AsyncCompute
+  vkDestroyCommandPool(m_device, m_async.computePool, nullptr);
+  vkDestroyCommandPool(m_device, m_async.graphicsPool, nullptr);
+  vkDestroySemaphore(m_device, m_async.semCompute, nullptr);
+  vkDestroySemaphore(m_device, m_async.semDisplay, nullptr);
 
   // Descriptors
   vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
@@ -249,7 +503,7 @@ void Simulator::destroyResources() {
 
   // Other
   m_picker.destroy();
-  m_scene.destroy();
+  m_scene.deinit();
   m_accelStruct.destroy();
   m_offscreen.destroy();
   m_skydome.destroy();
@@ -260,6 +514,10 @@ void Simulator::destroyResources() {
     p->destroy();
     p = nullptr;
   }
+  m_renderValid.fill(false);
+
+  // Serializing the pipeline cache to disk for the next run
+  m_pipelineCache.deinit();
   // #ifdef NVP_SUPPORTS_OPTIX7
   //   m_denoiser->destroy();
   // #endif
@@ -300,15 +558,16 @@ void Simulator::createRender(RndMethod method) {
     return;
 
   LOGI("Switching renderer, from %d to %d \n", m_rndMethod, method);
-  if (m_rndMethod != eNone) {
-    vkDeviceWaitIdle(m_device);  // cannot destroy while in use
-    m_pRender[m_rndMethod]->destroy();
-  }
   m_rndMethod = method;
 
-  m_pRender[m_rndMethod]->create(
-    m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout},
-    &m_scene);
+  // Renderers stay alive once built against the current descriptor layouts, so switching
+  // back and forth is free; a first-time build is still cheap with the warm pipeline cache.
+  if (!m_renderValid[method]) {
+    m_pRender[m_rndMethod]->create(
+      m_size, {m_accelStruct.getDescLayout(), m_offscreen.getDescLayout(), m_scene.getDescLayout(), m_descSetLayout},
+      &m_scene);
+    m_renderValid[method] = true;
+  }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -348,7 +607,11 @@ void Simulator::drawPost(VkCommandBuffer cmdBuf) {
   vkCmdSetViewport(cmdBuf, 0, 1, &viewport);
   vkCmdSetScissor(cmdBuf, 0, 1, &scissor);
 
-  m_offscreen.m_tonemapper.zoom           = m_descaling ? 1.0f / m_descalingLevel : 1.0f;
+  // #DynRes : continuous render scale instead of the fixed manual level; the post shader
+  // reconstructs the full region from the scaled image with a filtered fetch
+  const float scale = m_descaling ? (m_settings.dynamicResolution ? m_renderScale : 1.0f / m_descalingLevel) : 1.0f;
+  m_offscreen.m_tonemapper.zoom           = scale;
+  m_offscreen.m_tonemapper.upscale        = scale < 1.0f ? 1 : 0;
   m_offscreen.m_tonemapper.renderingRatio = size / area;
   m_offscreen.run(cmdBuf);
 
@@ -437,22 +700,109 @@ void Simulator::renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& pro
 
   auto sec = profiler.timeRecurring("Render", cmdBuf);
 
-  // We are done rendering
-  if (m_rtxState.frame >= m_maxFrames)
+  // We are done rendering; with tiling, tiles accumulate at their own pace and finish later
+  bool done = m_rtxState.frame >= m_maxFrames;
+  if (m_tiles.enable && !m_tiles.tileFrame.empty())
+    done = *std::min_element(m_tiles.tileFrame.begin(), m_tiles.tileFrame.end()) >= m_maxFrames;
+  if (done)
     return;
 
   // Handling de-scaling by reducing the size to render
   VkExtent2D render_size = m_renderRegion.extent;
-  if (m_descaling)
-    render_size = VkExtent2D{render_size.width / m_descalingLevel, render_size.height / m_descalingLevel};
+  if (m_descaling) {
+    // #DynRes : closed-loop render scale while navigating. The measured GPU time of the
+    // "Render" section steers the scale toward the frame budget, replacing the fixed manual
+    // level; drawPost reconstructs the full region from the scaled image. The scale only moves
+    // while the accumulation restarts, so a standing accumulation keeps a consistent size.
+    if (m_settings.dynamicResolution) {
+      nvh::Profiler::TimerInfo info;
+      if (m_rtxState.frame <= 0 && profiler.getTimerInfo("Render", info) && info.gpu.average > 0) {
+        const float measuredMs = static_cast<float>(info.gpu.average) / 1000.f;
+        // Pixel count scales with the square of the factor; damped to avoid oscillation
+        const float wanted = m_renderScale * std::sqrt(m_settings.targetFrameTimeMs / measuredMs);
+        m_renderScale      = std::clamp(m_renderScale + 0.25f * (wanted - m_renderScale), 0.25f, 1.f);
+      }
+      render_size = VkExtent2D{std::max(1u, static_cast<uint32_t>(render_size.width * m_renderScale)),
+                               std::max(1u, static_cast<uint32_t>(render_size.height * m_renderScale))};
+    } else {
+      render_size = VkExtent2D{render_size.width / m_descalingLevel, render_size.height / m_descalingLevel};
+    }
+  } else {
+    m_renderScale = 1.f;  // #DynRes : back to full resolution once navigation stopped
+  }
 
   m_rtxState.size = {render_size.width, render_size.height};
   // m_rtxState.size = {1920, 1080};
-  // State is the push constant structure
-  m_pRender[m_rndMethod]->setPushContants(m_rtxState);
-  // Running the renderer
-  m_pRender[m_rndMethod]->run(cmdBuf, render_size, profiler,
-                              {m_accelStruct.getDescSet(), m_offscreen.getDescSet(), m_scene.getDescSet(), m_descSet});
+
+  // #Refit : new node transforms for this frame, recorded ahead of the trace below
+  updateAnimation(cmdBuf);
+
+  // #AsyncCompute : the compute renderers (RayQuery, Wavefront) go to the dedicated compute
+  // queue, overlapped with
+  // the post-processing, GUI and present of the previous frame still running on graphics.
+  // Everything touching the render targets is recorded there; the frame command buffer only
+  // samples the display copy (see submitAsyncCompute). Note that the "Render" timer then only
+  // measures the graphics part of the frame, the overlap shows up in the frame rate.
+  // #MultiView : stays on the graphics queue, the inline view-matrix update of
+  // updateUniformBuffer is only ordered against dispatches recorded in the same command buffer
+  // #Refit : the TLAS refit above is recorded on the graphics command buffer, a compute-queue
+  // dispatch would not be ordered against it
+  const bool async = m_settings.asyncCompute && (m_rndMethod == eRayQuery || m_rndMethod == eWavefront)
+                     && !m_tiles.enable && m_settings.nbViews == 1 && !m_settings.animate;
+  VkCommandBuffer renderCmd = async ? beginAsyncCompute() : cmdBuf;
+
+  // #Adaptive : converged pixels stop tracing, the counter feeds the GUI convergence estimate
+  m_rtxState.adaptiveSampling  = m_settings.adaptiveSampling ? 1 : 0;
+  m_rtxState.adaptiveThreshold = m_settings.adaptiveThreshold;
+  if (m_settings.adaptiveSampling)
+    m_convergedPixels = m_offscreen.fetchConvergedCount(renderCmd);
+
+  // #Stats : ray counters of a previous frame, for the GUI
+  if (m_settings.rayStatistics)
+    fetchRayStats(renderCmd);
+
+  // #Reproject : keep the history image up to date while enabled; at frame 0 after a camera
+  // move, additionally seed the restarted accumulation from it. Tiling, de-scaling, the
+  // multi-view atlas and the debug views render something the history cannot stand in for.
+  m_rtxState.reproject = 0;
+  if (m_settings.reproject && !m_tiles.enable && m_settings.nbViews == 1
+      && !(m_descaling && (m_descalingLevel > 1 || (m_settings.dynamicResolution && m_renderScale < 1.f)))
+      && m_rtxState.accumulate == 1 && m_rtxState.debugging_mode == eNoDebug) {
+    m_rtxState.reproject = (m_rtxState.frame == 0 && m_reprojectHistory) ? 2 : 1;
+  }
+
+  if (m_tiles.enable && !m_descaling) {
+    renderSceneTiled(cmdBuf, profiler, render_size);
+  } else {
+    m_rtxState.tileOffset  = {0, 0};
+    VkExtent2D launch_size = render_size;
+    // #MultiGPU : this device only renders its horizontal slice of the frame
+    if (m_renderSlice.extent.width != 0) {
+      m_rtxState.tileOffset = {m_renderSlice.offset.x, m_renderSlice.offset.y};
+      launch_size           = m_renderSlice.extent;
+    }
+    // State is the push constant structure
+    m_pRender[m_rndMethod]->setPushContants(m_rtxState);
+    // Running the renderer
+    m_pRender[m_rndMethod]->run(renderCmd, launch_size, profiler,
+                                {m_accelStruct.getDescSet(), m_offscreen.getDescSet(), m_scene.getDescSet(), m_descSet},
+                                m_dynOffsets);
+
+    // #Reproject : the frame is complete, keep it as the warp source for the next reset
+    if (m_rtxState.reproject != 0) {
+      m_offscreen.copyToHistory(renderCmd);
+      m_reprojectHistory = true;
+    }
+  }
+
+  // #AsyncCompute : submit the dispatch and the display copy; while the setting is on the
+  // tonemapper keeps sampling the display image, so a frame falling back to the graphics queue
+  // (tiling, RTX pipeline) refreshes the copy inline instead
+  if (async) {
+    submitAsyncCompute();
+  } else if (m_settings.asyncCompute) {
+    m_offscreen.copyToDisplay(cmdBuf);
+  }
 
   //   // denoising
   // #ifdef NVP_SUPPORTS_OPTIX7
@@ -485,13 +835,256 @@ void Simulator::renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& pro
   //   }
   // #endif
 
-  // For automatic brightness tonemapping
-  if (m_offscreen.m_tonemapper.autoExposure) {
+  // For automatic brightness tonemapping; with async compute the pyramid is rebuilt on the
+  // display copy, inside the copy submission (see submitAsyncCompute)
+  if (m_offscreen.m_tonemapper.autoExposure && !async) {
     auto slot = profiler.timeRecurring("Mipmap", cmdBuf);
     m_offscreen.genMipmap(cmdBuf);
   }
 }
 
+//--------------------------------------------------------------------------------------------------
+// #Tiling
+// Renders a budgeted subset of checkerboarded tiles instead of the full render region, bounding
+// the GPU time of a single frame. Each tile carries its own frame count in the push constant, so
+// the accumulation in pathtrace.rgen/pathtrace.comp stays correct across tiles.
+//
+void Simulator::renderSceneTiled(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& profiler, const VkExtent2D& render_size) {
+  const int     tileSize = std::max(64, m_tiles.tileSize);
+  nvmath::vec2i grid((render_size.width + tileSize - 1) / tileSize, (render_size.height + tileSize - 1) / tileSize);
+  const int     nbTiles = grid.x * grid.y;
+
+  // (Re)build the checkerboarded visit order when the grid changes
+  if (grid.x != m_tiles.grid.x || grid.y != m_tiles.grid.y) {
+    m_tiles.grid = grid;
+    m_tiles.tileOrder.clear();
+    m_tiles.tileOrder.reserve(nbTiles);
+    for (int parity = 0; parity < 2; parity++)
+      for (int y = 0; y < grid.y; y++)
+        for (int x = 0; x < grid.x; x++)
+          if (((x + y) & 1) == parity)
+            m_tiles.tileOrder.push_back(y * grid.x + x);
+    m_tiles.nextTile = 0;
+    m_tiles.tileFrame.assign(nbTiles, 0);
+  }
+
+  // Camera moved, all tiles restart their accumulation
+  if (m_rtxState.frame <= 0)
+    std::fill(m_tiles.tileFrame.begin(), m_tiles.tileFrame.end(), 0);
+
+  // Fit the number of tiles submitted this frame to the render budget, based on the measured
+  // per-tile cost of the previous frames
+  nvh::Profiler::TimerInfo info;
+  if (profiler.getTimerInfo("Render", info)) {
+    float perTileMs = static_cast<float>(info.gpu.average) / 1000.f / std::max(1, m_tiles.tilesPerFrame);
+    if (perTileMs > 0.f)
+      m_tiles.tilesPerFrame = std::clamp(static_cast<int>(m_tiles.targetFrameTimeMs / perTileMs), 1, nbTiles);
+  }
+
+  RtxState tileState = m_rtxState;
+  for (int i = 0; i < m_tiles.tilesPerFrame; i++) {
+    const uint32_t tile = m_tiles.tileOrder[m_tiles.nextTile];
+    m_tiles.nextTile    = (m_tiles.nextTile + 1) % static_cast<uint32_t>(nbTiles);
+
+    if (m_tiles.tileFrame[tile] >= m_maxFrames)
+      continue;  // This tile is fully converged
+
+    tileState.tileOffset = {static_cast<int>(tile) % grid.x * tileSize, static_cast<int>(tile) / grid.x * tileSize};
+    tileState.frame      = m_tiles.tileFrame[tile]++;
+    m_pRender[m_rndMethod]->setPushContants(tileState);
+
+    // Border tiles are clamped to the render region; the shaders also guard against overrun
+    VkExtent2D tileExtent{std::min(static_cast<uint32_t>(tileSize), render_size.width - tileState.tileOffset.x),
+                          std::min(static_cast<uint32_t>(tileSize), render_size.height - tileState.tileOffset.y)};
+    m_pRender[m_rndMethod]->run(cmdBuf, tileExtent, profiler,
+                                {m_accelStruct.getDescSet(), m_offscreen.getDescSet(), m_scene.getDescSet(), m_descSet},
+                                m_dynOffsets);
+  }
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless
+// Unattended batch rendering: no window, swapchain or vsync-coupled fences. The scene is loaded
+// synchronously, all frames are rendered back-to-back into the offscreen image and the result is
+// written to disk. Call after setup(), instead of the windowed create* path.
+//
+void Simulator::renderHeadless(const std::string& sceneFile, const std::string& hdrFilename, const VkExtent2D& size,
+                               int frames, const std::string& outFilename) {
+  loadEnvironmentHdr(hdrFilename);
+  loadScene(sceneFile);
+  prepareHeadless(size, eRtxPipeline);
+
+  m_rtxState.accumulate = 1;
+  m_maxFrames           = frames;
+  resetFrame();
+
+  nvvk::ProfilerVK profiler;
+  profiler.init(m_device, m_physicalDevice, m_graphicsQueueIndex);
+
+  LOGI("Headless: rendering %d frames at %dx%d\n", frames, size.width, size.height);
+  MilliTimer        timer;
+  nvvk::CommandPool cmdPool(m_device, m_graphicsQueueIndex);
+  for (int f = 0; f < frames; f++) {
+    auto cmdBuf = cmdPool.createCommandBuffer();
+    profiler.beginFrame();
+
+    m_rtxState.frame = f;
+    updateUniformBuffer(cmdBuf);
+    renderScene(cmdBuf, profiler);
+
+    profiler.endFrame();
+    cmdPool.submitAndWait(cmdBuf);
+  }
+  timer.print();
+
+  if (!outFilename.empty())
+    saveImage(outFilename);
+  profiler.deinit();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless / #Bench
+// The setup half of renderHeadless, once the scene and the environment are loaded: render
+// region, uniforms, descriptors, offscreen targets and the requested renderer. The benchmark
+// drives its own frame loop and renderer switches around this.
+//
+void Simulator::prepareHeadless(const VkExtent2D& size, RndMethod method) {
+  m_size         = size;
+  m_renderRegion = {{0, 0}, size};
+  CameraManip.setWindowSize(size.width, size.height);
+
+  createUniformBuffer();
+  createDescriptorSetLayout();
+  m_offscreen.update(size);  // Offscreen targets and descriptors only, no post pipeline
+  createRender(method);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless
+// Downloads the offscreen RGBA32F image and writes it to disk; .hdr keeps the radiance values,
+// anything else is clamped to 8-bit.
+//
+void Simulator::saveImage(const std::string& outFilename) {
+  std::vector<float> pixels;
+  readImage(m_renderRegion, pixels);
+  writeImage(outFilename, m_renderRegion.extent, pixels.data());
+}
+
+//--------------------------------------------------------------------------------------------------
+// #HalfPrec : scalar half to float, for the readback of RGBA16F targets
+//
+float Simulator::halfToFloat(uint16_t h) {
+  const uint32_t sign = (h & 0x8000u) << 16;
+  uint32_t       exp  = (h >> 10) & 0x1Fu;
+  uint32_t       mant = h & 0x3FFu;
+  uint32_t       bits;
+  if (exp == 0) {
+    if (mant == 0) {
+      bits = sign;  // Signed zero
+    } else {
+      exp = 127 - 15 + 1;  // Subnormal, renormalize
+      while ((mant & 0x400u) == 0) {
+        mant <<= 1;
+        exp--;
+      }
+      bits = sign | (exp << 23) | ((mant & 0x3FFu) << 13);
+    }
+  } else if (exp == 31) {
+    bits = sign | 0x7F800000u | (mant << 13);  // Inf / NaN
+  } else {
+    bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+  }
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless / #MultiGPU
+// Downloads a region of the offscreen image to the host as RGBA32F, expanding on the host when
+// the target is RGBA16F (#HalfPrec); a multi-GPU run reads only the slice this device rendered,
+// the gather happens on the host.
+//
+void Simulator::readImage(const VkRect2D& region, std::vector<float>& pixels) {
+  const VkExtent2D&  size       = region.extent;
+  const bool         half       = m_offscreen.getColorFormat() == VK_FORMAT_R16G16B16A16_SFLOAT;
+  const VkDeviceSize texelBytes = half ? 4 * sizeof(uint16_t) : 4 * sizeof(float);
+  const VkDeviceSize bufSize    = static_cast<VkDeviceSize>(size.width) * size.height * texelBytes;
+  pixels.resize(static_cast<size_t>(size.width) * size.height * 4);
+
+  nvvk::Buffer pixelBuffer =
+    m_alloc.createBuffer(bufSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  {
+    nvvk::CommandPool genCmdBuf(m_device, m_graphicsQueueIndex);
+    auto              cmdBuf = genCmdBuf.createCommandBuffer();
+
+    const VkImage& image = m_offscreen.GetFinalImage().image;
+    nvvk::cmdBarrierImageLayout(cmdBuf, image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    VkBufferImageCopy copyRegion{};
+    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copyRegion.imageSubresource.layerCount = 1;
+    copyRegion.imageOffset                 = {region.offset.x, region.offset.y, 0};
+    copyRegion.imageExtent                 = {size.width, size.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pixelBuffer.buffer, 1, &copyRegion);
+
+    nvvk::cmdBarrierImageLayout(cmdBuf, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL);
+    genCmdBuf.submitAndWait(cmdBuf);
+  }
+
+  if (half) {
+    const uint16_t* src = static_cast<const uint16_t*>(m_alloc.map(pixelBuffer));
+    for (size_t i = 0; i < pixels.size(); i++)
+      pixels[i] = halfToFloat(src[i]);
+  } else {
+    memcpy(pixels.data(), m_alloc.map(pixelBuffer), static_cast<size_t>(bufSize));
+  }
+  m_alloc.unmap(pixelBuffer);
+  m_alloc.destroy(pixelBuffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Headless
+// Writes RGBA32F pixels to disk; .hdr keeps the radiance values, anything else is clamped to 8-bit.
+//
+void Simulator::writeImage(const std::string& outFilename, const VkExtent2D& size, const float* pixels) {
+  if (outFilename.size() > 4 && outFilename.compare(outFilename.size() - 4, 4, ".hdr") == 0) {
+    stbi_write_hdr(outFilename.c_str(), size.width, size.height, 4, pixels);
+  } else {
+    std::vector<uint8_t> ldr(static_cast<size_t>(size.width) * size.height * 4);
+    for (size_t i = 0; i < ldr.size(); i++)
+      ldr[i] = static_cast<uint8_t>(powf(std::min(std::max(pixels[i], 0.f), 1.f), 1.f / 2.2f) * 255.f);  // sRGB-ish
+    stbi_write_png(outFilename.c_str(), size.width, size.height, 4, ldr.data(), size.width * 4);
+  }
+  LOGI("Headless: wrote %s\n", outFilename.c_str());
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Stream
+// Remote view: fence-paced readback ring on the graphics queue feeding a TCP stream of the
+// rendered frames (see frame_stream.hpp). A port of 0 leaves it disabled.
+//
+void Simulator::initFrameStream(int port) {
+  m_frameStream.setup(m_device, m_graphicsQueueIndex, m_queue, &m_alloc);
+  m_frameStream.init(port);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Stream
+// Called right after submitFrame: queue order puts the copy behind this frame's rendering and
+// the ring drops the frame when full, so the render loop is never stalled
+//
+void Simulator::streamFrame() {
+  if (m_busy || !m_frameStream.active())
+    return;
+  // #AsyncCompute : the next dispatch may already be overwriting the result image on the
+  // compute queue; the display copy holds the same frame and stays on the graphics queue
+  const nvvk::Texture src = m_settings.asyncCompute ? m_offscreen.GetDisplayImage() : m_offscreen.GetFinalImage();
+  m_frameStream.record(src, m_renderRegion, m_offscreen.getColorFormat(), m_rtxState.frame);
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Keyboard / Drag and Drop
 //////////////////////////////////////////////////////////////////////////
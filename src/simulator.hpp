@@ -54,6 +54,7 @@ typedef nvvk::ResourceAllocatorDedicated Allocator;
 
 #include "accelstruct.hpp"
 #include "appbase.hpp"
+#include "frame_stream.hpp"
 #include "imgui_internal.h"
 #include "nvh/gltfscene.hpp"
 #include "nvvk/debug_util_vk.hpp"
@@ -61,6 +62,7 @@ typedef nvvk::ResourceAllocatorDedicated Allocator;
 #include "nvvk/raypicker_vk.hpp"
 #include "nvvk/raytraceKHR_vk.hpp"
 #include "nvvkhl/hdr_env.hpp"
+#include "pipeline_cache.hpp"
 #include "queue.hpp"
 #include "render_output.hpp"
 #include "scene.hpp"
@@ -82,6 +84,7 @@ public:
   enum RndMethod {
     eRtxPipeline,
     eRayQuery,
+    eWavefront,  // #Wavefront : generate/trace/shade kernels with compacted ray queues
     eNone,
   };
 
@@ -110,10 +113,39 @@ public:
   void screenPicking();
   void updateFrame();
   void updateHdrDescriptors();
+  void updateAnimation(const VkCommandBuffer& cmdBuf);  // #Refit : turntable + TLAS refit
   void updateUniformBuffer(const VkCommandBuffer& cmdBuf);
   void copyImagesToCuda(VkCommandBuffer cmd);
+  void fetchRayStats(const VkCommandBuffer& cmdBuf);  // #Stats
   void submitSignalSemaphore(const VkCommandBuffer& cmdBuf);
 
+  // #AsyncCompute : the RayQuery dispatch of frame N runs on the dedicated compute queue,
+  // overlapped with the post-processing / GUI / present of frame N-1 on the graphics queue
+  void            createAsyncCompute(const nvvk::Queue& queue);
+  VkCommandBuffer beginAsyncCompute();
+  void            submitAsyncCompute();
+
+  // #Headless : unattended batch rendering, no window / swapchain / vsync. An empty outFilename
+  // skips writing, the caller reads the pixels back instead (see readImage)
+  void renderHeadless(const std::string& sceneFile, const std::string& hdrFilename, const VkExtent2D& size, int frames,
+                      const std::string& outFilename);
+  // #Bench : setup half of renderHeadless, after the scene and environment are loaded
+  void prepareHeadless(const VkExtent2D& size, RndMethod method);
+  void saveImage(const std::string& outFilename);
+  void readImage(const VkRect2D& region, std::vector<float>& pixels);
+  static void  writeImage(const std::string& outFilename, const VkExtent2D& size, const float* pixels);
+  static float halfToFloat(uint16_t h);  // #HalfPrec : scalar half to float, for readbacks
+
+  // #Stream : remote view, the frame is copied into the readback ring right after submit
+  void initFrameStream(int port);
+  void streamFrame();
+
+  // #MultiGPU : restricts rendering to a horizontal slice of the frame; each device of a
+  // multi-GPU headless run renders its own slice (empty extent renders the whole frame)
+  void setRenderSlice(const VkRect2D& slice) {
+    m_renderSlice = slice;
+  }
+
   nvvk::Context m_ctx{};
 
   Scene              m_scene;
@@ -122,6 +154,7 @@ public:
   HdrSampling        m_skydome;
   nvvk::AxisVK       m_axis;
   nvvk::RayPickerKHR m_picker;
+  FrameStream        m_frameStream;  // #Stream : async readback ring for the remote view
 
   // It is possible that ray query isn't supported (ex. Titan)
   void supportRayQuery(bool support) {
@@ -130,10 +163,20 @@ public:
   bool m_supportRayQuery{true};
 
   // All renderers
-  std::array<Renderer*, eNone> m_pRender{nullptr, nullptr};
+  std::array<Renderer*, eNone> m_pRender{nullptr, nullptr, nullptr};
+  std::array<bool, eNone>      m_renderValid{false, false, false};  // Pipeline built against current layouts
   RndMethod                    m_rndMethod{eNone};
 
+  PipelineCacheFile m_pipelineCache;  // Persisted to disk between runs
+
   nvvk::Buffer m_sunAndSkyBuffer;
+  nvvk::Buffer m_rayStatsBuffer;  // #Stats : atomic ray counters, host visible
+
+  // Per-frame uniform ring: persistently mapped slots selected with dynamic offsets at bind time
+  uint32_t              m_frameSlot{0};
+  uint32_t              m_sunSkySlotSize{0};
+  uint8_t*              m_sunSkyMapped{nullptr};
+  std::vector<uint32_t> m_dynOffsets{0, 0};  // {camera (S_SCENE), sun&sky (S_ENV)}
 
   // Graphic pipeline
   VkDescriptorPool            m_descPool{VK_NULL_HANDLE};
@@ -145,6 +188,7 @@ public:
   nvvk::DebugUtil m_debug;  // Utility to name objects
 
   VkRect2D m_renderRegion{};
+  VkRect2D m_renderSlice{{0, 0}, {0, 0}};  // #MultiGPU : this device's part of the frame
   void     setRenderRegion(const VkRect2D& size);
 
   // #Post
@@ -153,6 +197,7 @@ public:
 
   // #VKRay
   void renderScene(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& profiler);
+  void renderSceneTiled(const VkCommandBuffer& cmdBuf, nvvk::ProfilerVK& profiler, const VkExtent2D& render_size);
 
   RtxState m_rtxState{
     0,       // frame;
@@ -162,13 +207,31 @@ public:
     1,       // hdrMultiplier;
     0,       // debugging_mode;
     0,       // pbrMode;
-    0,       // _pad0;
+    0,       // denoiseWrite;
     {0, 0},  // size;
     0,       // minHeatmap;
     65000,   // maxHeatmap;
     0,       // accumulate
+    {0, 0},  // tileOffset;
+    0,       // adaptiveSampling;
+    0.03f,   // adaptiveThreshold;
+    0,       // reproject;
   };
 
+  // #Tiling
+  // Splits the render region in checkerboarded tiles and submits only a budgeted subset per frame,
+  // keeping the GPU latency of a single frame below the target. Each tile accumulates at its own pace.
+  struct TileScheduler {
+    bool                  enable{false};
+    int                   tileSize{256};          // Tile edge in pixels
+    float                 targetFrameTimeMs{33.3f};  // Budget for the "Render" section
+    int                   tilesPerFrame{1};       // Adjusted every frame against the budget
+    uint32_t              nextTile{0};            // Round-robin position in m_tileOrder
+    nvmath::vec2i         grid{0, 0};             // Number of tiles in x/y
+    std::vector<int>      tileFrame;              // Per-tile accumulated frame count
+    std::vector<uint32_t> tileOrder;              // Checkerboarded visit order
+  } m_tiles;
+
   SunAndSky m_sunAndSky{
     {1, 1, 1},            // rgb_unit_conversion;
     0.0000101320f,        // multiplier;
@@ -192,6 +255,7 @@ public:
   bool        m_showAxis{true};
   bool        m_descaling{false};
   int         m_descalingLevel{1};
+  float       m_renderScale{1.f};  // #DynRes : current scale, steered against the frame budget
   bool        m_busy{false};
   std::string m_busyReasonText;
 
@@ -220,5 +284,41 @@ public:
     bool          denoiseApply{true};
     bool          denoiseFirstFrame{false};
     int           denoiseEveryNFrames{100};
+    bool          adaptiveSampling{false};
+    float         adaptiveThreshold{0.03f};  // Relative standard error per pixel
+    bool          rayStatistics{false};      // #Stats : compile the ray counters in the pipelines
+    bool          reproject{true};           // #Reproject : warm-start accumulation after camera moves
+    bool          asyncCompute{false};       // #AsyncCompute : RayQuery dispatch on the compute queue
+    bool          dynamicResolution{true};   // #DynRes : closed-loop render scale while navigating
+    float         targetFrameTimeMs{33.3f};  // #DynRes : budget for the "Render" section
+    bool          halfPrecision{false};      // #HalfPrec : RGBA16F targets, compensated accumulation
+    int           nbViews{1};                // #MultiView : sensor-rig views rendered as one atlas dispatch
+    bool          animate{false};            // #Refit : turntable the scene, TLAS refit every frame
   } m_settings;
+
+  // #Adaptive : converged pixels of a previous frame, for the GUI convergence estimate
+  uint32_t m_convergedPixels{0};
+
+  // #Stats : ray counters of a previous frame, for the GUI
+  RayStats m_rayStats{};
+
+  // #Reproject : the history image holds the last completed frame; resets other than camera
+  // motion (scene edits, setting changes) discard it
+  bool m_reprojectHistory{false};
+
+  // #AsyncCompute : command buffers and timeline semaphores of the compute-queue path. The
+  // semaphores carry the monotonic frame counter: the dispatch of frame N waits for the display
+  // copy of N-1 (semDisplay) and the copy waits for the dispatch (semCompute).
+  struct AsyncCompute {
+    static constexpr uint32_t s_ringSize{3};  // In-flight async frames, matches the swapchain depth
+
+    nvvk::Queue                             queue;  // Simulator::eCompute
+    VkCommandPool                           computePool{VK_NULL_HANDLE};
+    VkCommandPool                           graphicsPool{VK_NULL_HANDLE};
+    std::array<VkCommandBuffer, s_ringSize> computeCmd{};  // Path-trace dispatch of frame N
+    std::array<VkCommandBuffer, s_ringSize> copyCmd{};     // Result -> display copy of frame N
+    VkSemaphore                             semCompute{VK_NULL_HANDLE};  // Timeline, dispatch N done
+    VkSemaphore                             semDisplay{VK_NULL_HANDLE};  // Timeline, display copy N done
+    uint64_t                                frame{0};                    // Async frames submitted so far
+  } m_async;
 };
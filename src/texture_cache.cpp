@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "texture_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "nvh/nvprint.hpp"
+
+namespace
+{
+
+// File layout: header, per-mip {width, height, size}, then the mip payloads back to back
+struct CacheHeader
+{
+  uint32_t magic{0x5854564E};  // 'NVTX'
+  uint32_t version{2};  // 2: fixed red/blue order of the BC3 endpoints
+  uint32_t format{0};  // VkFormat
+  uint32_t width{0};
+  uint32_t height{0};
+  uint32_t mipLevels{0};
+};
+
+struct CacheMipInfo
+{
+  uint32_t width{0};
+  uint32_t height{0};
+  uint64_t size{0};
+};
+
+//--------------------------------------------------------------------------------------------------
+// BC3 (DXT5) block compression: good-enough bounding-box endpoints, no search.
+// A 4x4 RGBA8 block becomes 16 bytes: 8 bytes of 3-bit alpha indices, 8 bytes of 2-bit color.
+//
+// The source pixels are BGRA (FreeImage layout, what the uncached path uploads as
+// VK_FORMAT_B8G8R8A8_UNORM), the BC3 endpoints are RGB565: red comes from px[2]
+uint16_t to565(const uint8_t* px)
+{
+  return static_cast<uint16_t>(((px[2] >> 3) << 11) | ((px[1] >> 2) << 5) | (px[0] >> 3));
+}
+
+void encodeBC3Block(const uint8_t block[16 * 4], uint8_t out[16])
+{
+  // Alpha endpoints
+  uint8_t minA = 255, maxA = 0;
+  for(int i = 0; i < 16; i++)
+  {
+    minA = std::min(minA, block[i * 4 + 3]);
+    maxA = std::max(maxA, block[i * 4 + 3]);
+  }
+  out[0] = maxA;
+  out[1] = minA;
+
+  // 3-bit alpha indices against the 8 interpolated values
+  uint8_t alphaPal[8];
+  alphaPal[0] = maxA;
+  alphaPal[1] = minA;
+  for(int i = 1; i < 7; i++)
+    alphaPal[1 + i] = static_cast<uint8_t>(((7 - i) * maxA + i * minA) / 7);
+
+  uint64_t alphaBits = 0;
+  for(int i = 0; i < 16; i++)
+  {
+    int a = block[i * 4 + 3], best = 0, bestDist = 256;
+    for(int j = 0; j < 8; j++)
+    {
+      int d = std::abs(a - alphaPal[j]);
+      if(d < bestDist)
+      {
+        bestDist = d;
+        best     = j;
+      }
+    }
+    alphaBits |= static_cast<uint64_t>(best) << (3 * i);
+  }
+  for(int i = 0; i < 6; i++)
+    out[2 + i] = static_cast<uint8_t>(alphaBits >> (8 * i));
+
+  // Color endpoints: per-channel bounding box
+  uint8_t minC[3] = {255, 255, 255}, maxC[3] = {0, 0, 0};
+  for(int i = 0; i < 16; i++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      minC[c] = std::min(minC[c], block[i * 4 + c]);
+      maxC[c] = std::max(maxC[c], block[i * 4 + c]);
+    }
+  }
+
+  uint16_t c0 = to565(maxC);
+  uint16_t c1 = to565(minC);
+  if(c0 < c1)
+    std::swap(c0, c1);  // BC3 color block always uses the 4-color mode
+  out[8]  = static_cast<uint8_t>(c0);
+  out[9]  = static_cast<uint8_t>(c0 >> 8);
+  out[10] = static_cast<uint8_t>(c1);
+  out[11] = static_cast<uint8_t>(c1 >> 8);
+
+  // Palette: endpoints plus the two interpolants
+  int pal[4][3];
+  for(int c = 0; c < 3; c++)
+  {
+    pal[0][c] = maxC[c];
+    pal[1][c] = minC[c];
+    pal[2][c] = (2 * maxC[c] + minC[c]) / 3;
+    pal[3][c] = (maxC[c] + 2 * minC[c]) / 3;
+  }
+
+  uint32_t colorBits = 0;
+  for(int i = 0; i < 16; i++)
+  {
+    int best = 0, bestDist = INT32_MAX;
+    for(int j = 0; j < 4; j++)
+    {
+      int d = 0;
+      for(int c = 0; c < 3; c++)
+      {
+        int diff = block[i * 4 + c] - pal[j][c];
+        d += diff * diff;
+      }
+      if(d < bestDist)
+      {
+        bestDist = d;
+        best     = j;
+      }
+    }
+    colorBits |= static_cast<uint32_t>(best) << (2 * i);
+  }
+  memcpy(&out[12], &colorBits, 4);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Compresses a full RGBA8 level to BC3, clamping the edge blocks
+//
+std::vector<uint8_t> compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+  const uint32_t       bw = (width + 3) / 4;
+  const uint32_t       bh = (height + 3) / 4;
+  std::vector<uint8_t> result(static_cast<size_t>(bw) * bh * 16);
+
+  uint8_t block[16 * 4];
+  for(uint32_t by = 0; by < bh; by++)
+  {
+    for(uint32_t bx = 0; bx < bw; bx++)
+    {
+      for(uint32_t py = 0; py < 4; py++)
+      {
+        for(uint32_t px = 0; px < 4; px++)
+        {
+          uint32_t x = std::min(bx * 4 + px, width - 1);
+          uint32_t y = std::min(by * 4 + py, height - 1);
+          memcpy(&block[(py * 4 + px) * 4], &rgba[(static_cast<size_t>(y) * width + x) * 4], 4);
+        }
+      }
+      encodeBC3Block(block, &result[(static_cast<size_t>(by) * bw + bx) * 16]);
+    }
+  }
+  return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+// 2x2 box filter to the next mip level
+//
+std::vector<uint8_t> downsample(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t dstW, uint32_t dstH)
+{
+  std::vector<uint8_t> result(static_cast<size_t>(dstW) * dstH * 4);
+  for(uint32_t y = 0; y < dstH; y++)
+  {
+    for(uint32_t x = 0; x < dstW; x++)
+    {
+      uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+      uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+      for(int c = 0; c < 4; c++)
+      {
+        int sum = rgba[(static_cast<size_t>(y0) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y0) * width + x1) * 4 + c]
+                  + rgba[(static_cast<size_t>(y1) * width + x0) * 4 + c] + rgba[(static_cast<size_t>(y1) * width + x1) * 4 + c];
+        result[(static_cast<size_t>(y) * dstW + x) * 4 + c] = static_cast<uint8_t>(sum / 4);
+      }
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+//--------------------------------------------------------------------------------------------------
+// Maps the cache file and sets up the per-mip views into the payload
+//
+bool TextureCache::open(const std::string& cacheFile)
+{
+  close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(cacheFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file, &fileSize);
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+  m_mapped     = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+  m_mappedSize = static_cast<size_t>(fileSize.QuadPart);
+  m_file       = file;
+  m_mapping    = mapping;
+#else
+  int fd = ::open(cacheFile.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+  struct stat st;
+  fstat(fd, &st);
+  m_mapped     = static_cast<const uint8_t*>(mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0));
+  m_mappedSize = static_cast<size_t>(st.st_size);
+  m_fd         = fd;
+  if(m_mapped == MAP_FAILED)
+  {
+    m_mapped = nullptr;
+    close();
+    return false;
+  }
+#endif
+
+  if(m_mapped == nullptr || m_mappedSize < sizeof(CacheHeader))
+  {
+    close();
+    return false;
+  }
+
+  CacheHeader header;
+  memcpy(&header, m_mapped, sizeof(header));
+  if(header.magic != CacheHeader().magic || header.version != CacheHeader().version)
+  {
+    close();
+    return false;
+  }
+
+  m_format = static_cast<VkFormat>(header.format);
+  m_width  = header.width;
+  m_height = header.height;
+
+  const uint8_t* mipInfo = m_mapped + sizeof(CacheHeader);
+  const uint8_t* payload = mipInfo + header.mipLevels * sizeof(CacheMipInfo);
+  m_mips.resize(header.mipLevels);
+  for(uint32_t i = 0; i < header.mipLevels; i++)
+  {
+    CacheMipInfo info;
+    memcpy(&info, mipInfo + i * sizeof(CacheMipInfo), sizeof(info));
+    m_mips[i] = {info.width, info.height, payload, static_cast<size_t>(info.size)};
+    payload += info.size;
+  }
+  if(payload > m_mapped + m_mappedSize)  // Truncated file
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void TextureCache::close()
+{
+#ifdef _WIN32
+  if(m_mapped != nullptr)
+    UnmapViewOfFile(m_mapped);
+  if(m_mapping != nullptr)
+    CloseHandle(m_mapping);
+  if(m_file != nullptr)
+    CloseHandle(m_file);
+  m_file    = nullptr;
+  m_mapping = nullptr;
+#else
+  if(m_mapped != nullptr)
+    munmap(const_cast<uint8_t*>(m_mapped), m_mappedSize);
+  if(m_fd >= 0)
+    ::close(m_fd);
+  m_fd = -1;
+#endif
+  m_mapped     = nullptr;
+  m_mappedSize = 0;
+  m_mips.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Builds the mip chain on the CPU, compresses every level and writes the cache file
+//
+bool TextureCache::bake(const std::string& cacheFile, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+  CacheHeader header;
+  header.format = VK_FORMAT_BC3_UNORM_BLOCK;
+  header.width  = width;
+  header.height = height;
+
+  std::vector<CacheMipInfo>         mipInfos;
+  std::vector<std::vector<uint8_t>> payloads;
+
+  std::vector<uint8_t> level(rgba, rgba + static_cast<size_t>(width) * height * 4);
+  uint32_t             w = width, h = height;
+  while(true)
+  {
+    payloads.emplace_back(compressLevel(level.data(), w, h));
+    mipInfos.push_back({w, h, payloads.back().size()});
+    if(w == 1 && h == 1)
+      break;
+    uint32_t dstW = std::max(1u, w / 2);
+    uint32_t dstH = std::max(1u, h / 2);
+    level         = downsample(level.data(), w, h, dstW, dstH);
+    w             = dstW;
+    h             = dstH;
+  }
+  header.mipLevels = static_cast<uint32_t>(mipInfos.size());
+
+  FILE* file = fopen(cacheFile.c_str(), "wb");
+  if(file == nullptr)
+  {
+    LOGW("TextureCache: cannot write %s\n", cacheFile.c_str());
+    return false;
+  }
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(mipInfos.data(), sizeof(CacheMipInfo), mipInfos.size(), file);
+  for(const auto& payload : payloads)
+    fwrite(payload.data(), 1, payload.size(), file);
+  fclose(file);
+  return true;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+//--------------------------------------------------------------------------------------------------
+// Sidecar cache of GPU-ready textures: block compressed (BC3) with a full mip chain, baked next
+// to the source image on first load. Subsequent loads memory-map the compressed payload and copy
+// it straight into staging, skipping decode, mipmap blits and the 4x RGBA8 VRAM cost.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan_core.h>
+
+class TextureCache
+{
+public:
+  // One mip level inside the mapped payload
+  struct MipLevel
+  {
+    uint32_t       width{0};
+    uint32_t       height{0};
+    const uint8_t* data{nullptr};
+    size_t         size{0};
+  };
+
+  ~TextureCache() { close(); }
+
+  // Opens an existing cache file and maps its payload; false when missing or incompatible
+  bool open(const std::string& cacheFile);
+  void close();
+
+  // Generates the mip chain from RGBA8 pixels, compresses every level to BC3 and writes the
+  // cache file; false when the file cannot be written
+  static bool bake(const std::string& cacheFile, const uint8_t* rgba, uint32_t width, uint32_t height);
+
+  // Cache file next to the source image
+  static std::string cachePath(const std::string& imageFile) { return imageFile + ".nvtex"; }
+
+  VkFormat                     format() const { return m_format; }
+  uint32_t                     width() const { return m_width; }
+  uint32_t                     height() const { return m_height; }
+  const std::vector<MipLevel>& mips() const { return m_mips; }
+
+private:
+  VkFormat              m_format{VK_FORMAT_UNDEFINED};
+  uint32_t              m_width{0};
+  uint32_t              m_height{0};
+  std::vector<MipLevel> m_mips;
+
+  // Mapped file
+  const uint8_t* m_mapped{nullptr};
+  size_t         m_mappedSize{0};
+#ifdef _WIN32
+  void* m_file{nullptr};
+  void* m_mapping{nullptr};
+#else
+  int m_fd{-1};
+#endif
+};
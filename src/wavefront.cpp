@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ *  #Wavefront : path tracer split in generate / trace / shade kernels with GPU ray queues,
+ *  compacted between the bounces. See wavefront.hpp for the why and wavefront.glsl for the
+ *  queue layout; the host side below only resets the headers and launches the kernels, the
+ *  ray counts never leave the GPU (dispatch indirect).
+ */
+
+#include "wavefront.hpp"
+
+#include "nvh/alignment.hpp"
+#include "nvh/fileoperations.hpp"
+#include "nvvk/commands_vk.hpp"
+#include "nvvk/shaders_vk.hpp"
+#include "scene.hpp"
+#include "tools.hpp"
+
+// Shaders
+#include "autogen/wavefront_gen.comp.h"
+#include "autogen/wavefront_shade.comp.h"
+#include "autogen/wavefront_trace.comp.h"
+
+// Layout of m_queueBuffer, matching _WaveQueues in wavefront.glsl (scalar layout):
+// two WaveQueue headers, then wfDepth / wfSample / wfCapacity / wfPad, then the index arrays
+static constexpr VkDeviceSize s_queueControlOffset = 2 * sizeof(WaveQueue);
+static constexpr VkDeviceSize s_queueIndexOffset   = s_queueControlOffset + 4 * sizeof(int32_t);
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Wavefront::setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex,
+                      nvvk::ResourceAllocator* allocator) {
+  m_device     = device;
+  m_pAlloc     = allocator;
+  m_queueIndex = familyIndex;
+  m_debug.setup(device);
+}
+
+//--------------------------------------------------------------------------------------------------
+//
+//
+void Wavefront::destroy() {
+  vkDestroyPipeline(m_device, m_genPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_tracePipeline, nullptr);
+  vkDestroyPipeline(m_device, m_shadePipeline, nullptr);
+  vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
+  vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_descSetLayout, nullptr);
+
+  m_pAlloc->destroy(m_pathStateBuffer);
+  m_pAlloc->destroy(m_queueBuffer);
+  m_pAlloc->destroy(m_instanceBuffer);
+  m_capacity = 0;
+
+  m_genPipeline    = VK_NULL_HANDLE;
+  m_tracePipeline  = VK_NULL_HANDLE;
+  m_shadePipeline  = VK_NULL_HANDLE;
+  m_pipelineLayout = VK_NULL_HANDLE;
+  m_descPool       = VK_NULL_HANDLE;
+  m_descSetLayout  = VK_NULL_HANDLE;
+  m_descSet        = VK_NULL_HANDLE;
+}
+
+//--------------------------------------------------------------------------------------------------
+// Creation of the buffers, the extra descriptor set (S_WF) and the three pipelines
+//
+void Wavefront::create(const VkExtent2D& size, const std::vector<VkDescriptorSetLayout>& rtDescSetLayouts,
+                       Scene* scene) {
+  MilliTimer timer;
+  LOGI("Create Wavefront Pipeline");
+
+  createBuffers(size);
+  createInstanceBuffer(scene);
+  createDescriptorSet();
+  updateDescriptorSet();
+
+  std::vector<VkPushConstantRange> push_constants;
+  push_constants.push_back({VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RtxState)});
+
+  // The shared sets, plus S_WF owned by this renderer
+  std::vector<VkDescriptorSetLayout> layouts = rtDescSetLayouts;
+  layouts.push_back(m_descSetLayout);
+
+  VkPipelineLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  layout_info.pushConstantRangeCount = static_cast<uint32_t>(push_constants.size());
+  layout_info.pPushConstantRanges    = push_constants.data();
+  layout_info.setLayoutCount         = static_cast<uint32_t>(layouts.size());
+  layout_info.pSetLayouts            = layouts.data();
+  vkCreatePipelineLayout(m_device, &layout_info, nullptr, &m_pipelineLayout);
+
+  createPipelines();
+  timer.print();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Path states and ray queues, sized for the pixels of the render size. The queue headers are
+// reset with vkCmdUpdateBuffer before use, so nothing needs to be initialized here.
+//
+void Wavefront::createBuffers(const VkExtent2D& size) {
+  m_pAlloc->destroy(m_pathStateBuffer);
+  m_pAlloc->destroy(m_queueBuffer);
+
+  m_capacity = size.width * size.height;
+
+  m_pathStateBuffer = m_pAlloc->createBuffer(m_capacity * sizeof(WavePathState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  NAME_VK(m_pathStateBuffer.buffer);
+
+  // Two index queues of one uint per pixel, behind the headers and the control ints
+  m_queueBuffer = m_pAlloc->createBuffer(
+    s_queueIndexOffset + 2 * m_capacity * sizeof(uint32_t),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+  NAME_VK(m_queueBuffer.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The payload matrices are rebuilt in the shade kernel from the TLAS instance, instead of
+// being carried per ray; one WaveInstance per node, in the order the TLAS was built
+// (see AccelStructure::createTopLevelBuffer)
+//
+void Wavefront::createInstanceBuffer(Scene* scene) {
+  m_pAlloc->destroy(m_instanceBuffer);
+
+  std::vector<WaveInstance> instances;
+  instances.reserve(scene->getScene().m_nodes.size());
+  for (auto& node : scene->getScene().m_nodes) {
+    WaveInstance inst;
+    inst.objectToWorld = node.worldMatrix;
+    inst.worldToObject = nvmath::invert(node.worldMatrix);
+    instances.emplace_back(inst);
+  }
+
+  nvvk::CommandPool cmdGen(m_device, m_queueIndex);
+  VkCommandBuffer   cmdBuf = cmdGen.createCommandBuffer();
+  m_instanceBuffer         = m_pAlloc->createBuffer(cmdBuf, instances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  cmdGen.submitAndWait(cmdBuf);
+  m_pAlloc->finalizeAndReleaseStaging();
+  NAME_VK(m_instanceBuffer.buffer);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Bindless : the pipelines survive a scene hot-swap (fixed layouts), but the instance
+// transforms are a snapshot of the loaded scene; rebuild them and point the set at the new buffer
+//
+void Wavefront::onSceneChange(Scene* scene) {
+  createInstanceBuffer(scene);
+  updateDescriptorSet();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Refit : refreshing the transforms in place for animated nodes, recorded into the frame's
+// command buffer next to the TLAS refit (see Simulator::updateAnimation); the shade kernel of
+// this frame then reconstructs normals and world positions from the moved geometry
+//
+void Wavefront::updateInstanceTransforms(const VkCommandBuffer& cmdBuf, const std::vector<nvmath::mat4f>& matrices) {
+  std::vector<WaveInstance> instances;
+  instances.reserve(matrices.size());
+  for (auto& m : matrices) {
+    WaveInstance inst;
+    inst.objectToWorld = m;
+    inst.worldToObject = nvmath::invert(m);
+    instances.emplace_back(inst);
+  }
+  m_pAlloc->getStaging()->cmdToBuffer(cmdBuf, m_instanceBuffer.buffer, 0,
+                                      instances.size() * sizeof(WaveInstance), instances.data());
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The set S_WF, holding what only the wavefront kernels see
+//
+void Wavefront::createDescriptorSet() {
+  vkDestroyDescriptorPool(m_device, m_descPool, nullptr);
+  vkDestroyDescriptorSetLayout(m_device, m_descSetLayout, nullptr);
+
+  nvvk::DescriptorSetBindings bind;
+  bind.addBinding({WFBindings::eWFPathStates, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({WFBindings::eWFQueues, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({WFBindings::eWFInstances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+
+  m_descSetLayout = bind.createLayout(m_device);
+  m_descPool      = bind.createPool(m_device);
+  m_descSet       = nvvk::allocateDescriptorSet(m_device, m_descPool, m_descSetLayout);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Pointing the set to the current buffers; called again when the buffers were re-created
+//
+void Wavefront::updateDescriptorSet() {
+  nvvk::DescriptorSetBindings bind;
+  bind.addBinding({WFBindings::eWFPathStates, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({WFBindings::eWFQueues, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+  bind.addBinding({WFBindings::eWFInstances, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT});
+
+  VkDescriptorBufferInfo stateDesc{m_pathStateBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo queueDesc{m_queueBuffer.buffer, 0, VK_WHOLE_SIZE};
+  VkDescriptorBufferInfo instDesc{m_instanceBuffer.buffer, 0, VK_WHOLE_SIZE};
+
+  std::vector<VkWriteDescriptorSet> writes;
+  writes.emplace_back(bind.makeWrite(m_descSet, WFBindings::eWFPathStates, &stateDesc));
+  writes.emplace_back(bind.makeWrite(m_descSet, WFBindings::eWFQueues, &queueDesc));
+  writes.emplace_back(bind.makeWrite(m_descSet, WFBindings::eWFInstances, &instDesc));
+  vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// The three compute pipelines over the same layout, all specializing RAY_STATISTICS (id 0,
+// #Stats), DEBUG_FEATURES (id 1), PBR_MODE (id 2, #Variants) and HALF_PRECISION (id 3,
+// #HalfPrec) so the counter atomics, the debug outputs, the unused BRDF model and the
+// compensated accumulation compile out
+//
+void Wavefront::createPipelines() {
+  vkDestroyPipeline(m_device, m_genPipeline, nullptr);
+  vkDestroyPipeline(m_device, m_tracePipeline, nullptr);
+  vkDestroyPipeline(m_device, m_shadePipeline, nullptr);
+
+  std::array<int32_t, 4> specData{m_rayStatistics ? 1 : 0, m_debugFeatures ? 1 : 0, m_pbrMode, m_halfPrecision ? 1 : 0};
+  std::array<VkSpecializationMapEntry, 4> specEntries{{{0, 0, sizeof(int32_t)},
+                                                       {1, 1 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {2, 2 * sizeof(int32_t), sizeof(int32_t)},
+                                                       {3, 3 * sizeof(int32_t), sizeof(int32_t)}}};
+  VkSpecializationInfo specInfo{static_cast<uint32_t>(specEntries.size()), specEntries.data(), sizeof(specData),
+                                specData.data()};
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  computePipelineCreateInfo.layout                    = m_pipelineLayout;
+  computePipelineCreateInfo.stage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  computePipelineCreateInfo.stage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+  computePipelineCreateInfo.stage.pName               = "main";
+  computePipelineCreateInfo.stage.pSpecializationInfo = &specInfo;
+
+  computePipelineCreateInfo.stage.module = nvvk::createShaderModule(m_device, wavefront_gen_comp, sizeof(wavefront_gen_comp));
+  vkCreateComputePipelines(m_device, m_pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_genPipeline);
+  m_debug.setObjectName(m_genPipeline, "WavefrontGen");
+  vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
+
+  computePipelineCreateInfo.stage.module =
+    nvvk::createShaderModule(m_device, wavefront_trace_comp, sizeof(wavefront_trace_comp));
+  vkCreateComputePipelines(m_device, m_pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_tracePipeline);
+  m_debug.setObjectName(m_tracePipeline, "WavefrontTrace");
+  vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
+
+  computePipelineCreateInfo.stage.module =
+    nvvk::createShaderModule(m_device, wavefront_shade_comp, sizeof(wavefront_shade_comp));
+  vkCreateComputePipelines(m_device, m_pipelineCache, 1, &computePipelineCreateInfo, nullptr, &m_shadePipeline);
+  m_debug.setObjectName(m_shadePipeline, "WavefrontShade");
+  vkDestroyShaderModule(m_device, computePipelineCreateInfo.stage.module, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Stats : toggle the ray counters; rebuilds the pipelines with a new specialization constant
+//
+void Wavefront::useRayStatistics(bool enable) {
+  m_rayStatistics = enable;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipelines();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #Variants : select the debug-stripped / BRDF-fixed pipeline variants; rebuilds only on change
+//
+void Wavefront::useShaderVariant(bool debugFeatures, int pbrMode) {
+  if (m_debugFeatures == debugFeatures && m_pbrMode == pbrMode)
+    return;
+  m_debugFeatures = debugFeatures;
+  m_pbrMode       = pbrMode;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipelines();
+}
+
+//--------------------------------------------------------------------------------------------------
+// #HalfPrec : match the precision of the render targets; rebuilds only on change
+//
+void Wavefront::useHalfPrecision(bool enable) {
+  if (m_halfPrecision == enable)
+    return;
+  m_halfPrecision = enable;
+  if (m_pipelineLayout != VK_NULL_HANDLE)
+    createPipelines();
+}
+
+//--------------------------------------------------------------------------------------------------
+// Coarse barrier between the stages of a bounce: orders the header resets (transfer), the
+// queue/state writes and the indirect dispatch reads. One VkMemoryBarrier covering all of it
+// is cheap next to the dispatches it separates.
+//
+static void waveBarrier(VkCommandBuffer cmdBuf) {
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+                          | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+                         | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+//--------------------------------------------------------------------------------------------------
+// Recording one frame: per sample a generate dispatch over the pixels, then per bounce a
+// trace and a shade dispatch over the compacted queue of that bounce (dispatch indirect)
+//
+#define GROUP_SIZE 8  // Same group size as in the generate shader
+void Wavefront::run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
+                    const std::vector<VkDescriptorSet>& descSets, const std::vector<uint32_t>& dynOffsets) {
+  // The renderers are not re-created on resize; grow the buffers when the render size
+  // outgrows them (rare enough that the wait does not matter)
+  if (size.width * size.height > m_capacity) {
+    vkDeviceWaitIdle(m_device);
+    createBuffers(size);
+    updateDescriptorSet();
+  }
+
+  std::vector<VkDescriptorSet> sets = descSets;
+  sets.push_back(m_descSet);
+  vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0,
+                          static_cast<uint32_t>(sets.size()), sets.data(), static_cast<uint32_t>(dynOffsets.size()),
+                          dynOffsets.data());
+
+  // Sending the push constant information, shared by the three pipelines
+  vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RtxState), &m_state);
+
+  const WaveQueue emptyQueue{0, 1, 1, 0};  // groupsY/Z must stay 1 for the indirect dispatch
+
+  for (int smpl = 0; smpl < m_state.maxSamples; smpl++) {
+    // Control section of the queue buffer; a push constant cannot change between the
+    // dispatches of one command buffer, a small inline update can
+    const int32_t control[4]{0, smpl, static_cast<int32_t>(m_capacity), 0};
+    vkCmdUpdateBuffer(cmdBuf, m_queueBuffer.buffer, s_queueControlOffset, sizeof(control), control);
+    vkCmdUpdateBuffer(cmdBuf, m_queueBuffer.buffer, 0, sizeof(WaveQueue), &emptyQueue);
+    waveBarrier(cmdBuf);
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_genPipeline);
+    vkCmdDispatch(cmdBuf, (size.width + (GROUP_SIZE - 1)) / GROUP_SIZE, (size.height + (GROUP_SIZE - 1)) / GROUP_SIZE, 1);
+    waveBarrier(cmdBuf);
+
+    for (int depth = 0; depth < m_state.maxDepth; depth++) {
+      const VkDeviceSize inHeader = (depth & 1) * sizeof(WaveQueue);
+
+      if (depth > 0) {
+        const int32_t wfDepth{depth};
+        vkCmdUpdateBuffer(cmdBuf, m_queueBuffer.buffer, s_queueControlOffset, sizeof(wfDepth), &wfDepth);
+      }
+      // Reset the queue shade will push the survivors into
+      vkCmdUpdateBuffer(cmdBuf, m_queueBuffer.buffer, sizeof(WaveQueue) - inHeader, sizeof(WaveQueue), &emptyQueue);
+      waveBarrier(cmdBuf);
+
+      vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_tracePipeline);
+      vkCmdDispatchIndirect(cmdBuf, m_queueBuffer.buffer, inHeader);
+      waveBarrier(cmdBuf);
+
+      vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_shadePipeline);
+      vkCmdDispatchIndirect(cmdBuf, m_queueBuffer.buffer, inHeader);
+      waveBarrier(cmdBuf);
+    }
+  }
+}
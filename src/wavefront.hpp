@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * SPDX-FileCopyrightText: Copyright (c) 2021 NVIDIA CORPORATION
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "nvvk/debug_util_vk.hpp"
+#include "nvvk/descriptorsets_vk.hpp"
+#include "nvvk/profiler_vk.hpp"
+#include "nvvk/resourceallocator_vk.hpp"
+#include "renderer.h"
+#include "shaders/host_device.h"
+
+/*
+
+#Wavefront : compute path tracer split in generate / trace / shade kernels.
+
+The megakernel (see RayQuery) keeps one thread on a pixel for its whole path: warps stall on
+the longest path and diverge in the material code. Here each bounce is its own pair of
+dispatches over a compacted ray queue, so only live paths occupy threads and the divergent
+shading runs on dense warps. The queues stay on the GPU: shade pushes survivors with an
+atomic and the headers are dispatch-indirect commands, the host never reads a ray count.
+
+* Requiring, on top of the shared sets (Tlas, output image, scene):
+  - A set of its own (S_WF): path states, ray queues, per-instance transforms
+
+* Usage
+  - setup as usual
+  - create
+  - run
+*/
+class Wavefront : public Renderer {
+public:
+  void              setup(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t familyIndex,
+                          nvvk::ResourceAllocator* allocator) override;
+  void              destroy() override;
+  void              create(const VkExtent2D& size, const std::vector<VkDescriptorSetLayout>& rtDescSetLayouts,
+                           Scene* scene) override;
+  void              run(const VkCommandBuffer& cmdBuf, const VkExtent2D& size, nvvk::ProfilerVK& profiler,
+                        const std::vector<VkDescriptorSet>& descSets, const std::vector<uint32_t>& dynOffsets) override;
+  // #Bindless : the per-node transforms are per scene, rebuild them on a hot-swap
+  void              onSceneChange(Scene* scene) override;
+  // #Refit : new per-node transforms, recorded ahead of the dispatch using them
+  void              updateInstanceTransforms(const VkCommandBuffer& cmdBuf, const std::vector<nvmath::mat4f>& matrices);
+  void              useRayStatistics(bool enable);
+  void              useShaderVariant(bool debugFeatures, int pbrMode);
+  void              useHalfPrecision(bool enable);
+  const std::string name() override {
+    return std::string("WF");
+  }
+
+private:
+  void createBuffers(const VkExtent2D& size);
+  void createInstanceBuffer(Scene* scene);
+  void createDescriptorSet();
+  void updateDescriptorSet();
+  void createPipelines();
+
+  bool     m_rayStatistics{false};  // #Stats : compile the counter atomics in
+  bool     m_debugFeatures{false};  // #Variants : compile the debug outputs in
+  int      m_pbrMode{0};            // #Variants : 0-Disney, 1-Gltf, folded at compile time
+  bool     m_halfPrecision{false};  // #HalfPrec : compile the compensated accumulation in
+  uint32_t m_capacity{0};           // Pixels the state buffer and the queues can hold
+
+  nvvk::Buffer m_pathStateBuffer;  // WavePathState per pixel
+  nvvk::Buffer m_queueBuffer;      // Two WaveQueue headers, the control ints, two index arrays
+  nvvk::Buffer m_instanceBuffer;   // WaveInstance per TLAS instance
+
+  VkDescriptorPool      m_descPool{VK_NULL_HANDLE};
+  VkDescriptorSetLayout m_descSetLayout{VK_NULL_HANDLE};
+  VkDescriptorSet       m_descSet{VK_NULL_HANDLE};
+
+private:
+  // Setup
+  nvvk::ResourceAllocator* m_pAlloc{nullptr};  // Allocator for buffer, images, acceleration structures
+  nvvk::DebugUtil          m_debug;            // Utility to name objects
+  VkDevice                 m_device{VK_NULL_HANDLE};
+  uint32_t                 m_queueIndex{0};
+
+  VkPipelineLayout m_pipelineLayout{VK_NULL_HANDLE};
+  VkPipeline       m_genPipeline{VK_NULL_HANDLE};
+  VkPipeline       m_tracePipeline{VK_NULL_HANDLE};
+  VkPipeline       m_shadePipeline{VK_NULL_HANDLE};
+};